@@ -0,0 +1,47 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <new>
+#include <stdlib.h>
+#include "Stats.h"
+
+#if __cplusplus < 201103L
+#define NEW_THROW_SPEC throw(std::bad_alloc)
+#else
+#define NEW_THROW_SPEC
+#endif
+
+/*
+ * Allocation counting. Replacing the global allocator keeps the count
+ * exact without an external profiler; when statistics are off the only
+ * extra work is the branch in Stats::addAllocation(). Linked into the
+ * tadpole program only, never into libtadpole, so it cannot replace
+ * the allocator of a program embedding the library.
+ */
+void* operator new(size_t size) NEW_THROW_SPEC
+{
+    Stats::addAllocation();
+    void *p = malloc(size ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) throw()
+{
+    free(p);
+}
@@ -16,6 +16,11 @@
  */
 
 #include "Anomaly.h"
+#include <algorithm>
+#include <set>
+#include "FileSummary.h"
+#include "Spill.h"
+#include "Stats.h"
 
 bool AnomalyPair::intersects (AnomalyPair *pair)
 {
@@ -84,6 +89,21 @@ bool AnomalyPair::intersects (AnomalyPair *pair)
             );
 }
 
+/*
+ * Deep copy, with events of its own, so the copy can be widened without
+ * touching the pair it came from.
+ */
+AnomalyPair* AnomalyPair::copy()
+{
+    return new AnomalyPair(
+            new Anomaly(m_previous->getType(),
+                new LogEvent(m_previous->getPreviousEvent()),
+                new LogEvent(m_previous->getNextEvent())),
+            new Anomaly(m_next->getType(),
+                new LogEvent(m_next->getPreviousEvent()),
+                new LogEvent(m_next->getNextEvent())));
+}
+
 void AnomalyCollection::addLog(LoggedAnomaly* log) 
 { 
     m_logs.push_back(log); 
@@ -127,7 +147,290 @@ void AnomalyCollection::addLog(LoggedAnomaly* log)
                 p->getNextAnomaly()->getNextEvent()->getDateWritten());
 };
 
-void AnomalyCollection::addFile(file_info* file)
+//logs, not pairs: one log may add more than one pair
+size_t AnomalyCollection::getLogCount()
+{
+    std::set<LogInfo*> logs;
+    for (size_t i = 0; i < m_logs.size(); i++)
+        logs.insert(m_logs[i]->getLogInfo());
+    return logs.size();
+}
+
+AnomalyCollection::~AnomalyCollection()
+{
+    if (m_budget)
+        m_budget->release(m_files.size() * sizeof(file_ref) +
+                m_paths.getBytes());
+    for (size_t r = 0; r < m_runs.size(); r++)
+        fclose(m_runs[r]);
+    delete m_summary;
+}
+
+//whether t falls inside the anomaly by creation or by written time
+bool AnomalyCollection::contains(time_t t)
+{
+    Anomaly *previous = m_pair->getPreviousAnomaly();
+    Anomaly *next = m_pair->getNextAnomaly();
+    return (t > previous->getNextEvent()->getDateCreated() &&
+            t < next->getPreviousEvent()->getDateCreated()) ||
+        (t > previous->getNextEvent()->getDateWritten() &&
+         t < next->getPreviousEvent()->getDateWritten());
+}
+
+//the span covering both the creation and the written time windows
+void AnomalyCollection::getWindow(time_t &start, time_t &end)
+{
+    Anomaly *previous = m_pair->getPreviousAnomaly();
+    Anomaly *next = m_pair->getNextAnomaly();
+    start = std::min(previous->getNextEvent()->getDateCreated(),
+            previous->getNextEvent()->getDateWritten());
+    end = std::max(next->getPreviousEvent()->getDateCreated(),
+            next->getPreviousEvent()->getDateWritten());
+}
+
+/*
+ * Callers matching on several threads must hold a lock around this, as a
+ * spill clears the pool the strings are interned in.
+ */
+void AnomalyCollection::addFile(TSK_OFF_T fsOffset, TSK_INUM_T inum,
+        const char *volume, const char *path, const char *name)
 {
+    size_t pooled = m_paths.getBytes();
+    file_ref file;
+    file.fsOffset = fsOffset;
+    file.inum = inum;
+    file.path = m_paths.intern(path);
+    file.name = m_paths.intern(name);
+    file.volume = m_paths.intern(volume);
     m_files.push_back(file);
+    if (m_budget == NULL)
+        return;
+
+    //strings new to the pool are charged along with the match; runs are
+    //a share of the budget, so there are few of them whatever its size
+    m_budget->charge(sizeof(file_ref) + m_paths.getBytes() - pooled);
+    size_t held = m_files.size() * sizeof(file_ref) + m_paths.getBytes();
+    if (m_budget->exceeded() && m_files.size() >= SPILL_MIN_FILES &&
+            held >= m_budget->getLimit() / SPILL_RUN_DIVISOR)
+        spillFiles();
+}
+
+/*
+ * Write the matches held in memory, strings and all, to a sorted run and
+ * free them along with the pool. If the run cannot be written they stay
+ * in memory.
+ */
+void AnomalyCollection::spillFiles()
+{
+    FILE *run = m_budget->createRun();
+    if (run == NULL)
+        return;
+
+    std::sort(m_files.begin(), m_files.end(), file_order(&m_paths));
+    if (!writeFileRun(run, m_files, &m_paths))
+    {
+        fclose(run);
+        return;
+    }
+
+    m_runs.push_back(run);
+    m_spilled += m_files.size();
+    m_budget->release(m_files.size() * sizeof(file_ref) +
+            m_paths.getBytes());
+    std::vector<file_ref>().swap(m_files);
+    m_paths.clear();
+
+    if (m_runs.size() >= SPILL_FAN_IN)
+        mergeRuns();
+}
+
+/*
+ * Merge all runs into one, so a collection never holds more than
+ * SPILL_FAN_IN of them open. If the merged run cannot be written the
+ * runs are kept as they are.
+ */
+void AnomalyCollection::mergeRuns()
+{
+    FILE *merged = m_budget->createRun();
+    if (merged == NULL)
+        return;
+
+    RunMerge runs(m_runs);
+    file_info file;
+    bool written = true;
+    while (written && runs.next(file))
+        written = writeFileInfo(merged, file);
+    if (!written || fflush(merged) != 0)
+    {
+        fclose(merged);
+        return;
+    }
+
+    for (size_t r = 0; r < m_runs.size(); r++)
+        fclose(m_runs[r]);
+    m_runs.assign(1, merged);
+}
+
+/*
+ * Log results share events between neighbouring pairs, so each event and
+ * anomaly is freed once through a set.
+ */
+void releaseLoggedAnomalies(const std::vector<LoggedAnomalies*> &logged)
+{
+    std::set<Anomaly*> anomalies;
+    std::set<LogEvent*> events;
+    for (size_t i = 0; i < logged.size(); i++)
+    {
+        std::vector<AnomalyPair*> pairs = logged[i]->getPairs();
+        for (size_t p = 0; p < pairs.size(); p++)
+        {
+            Anomaly *ends[2] = {pairs[p]->getPreviousAnomaly(),
+                pairs[p]->getNextAnomaly()};
+            for (int a = 0; a < 2; a++)
+            {
+                anomalies.insert(ends[a]);
+                events.insert(ends[a]->getPreviousEvent());
+                events.insert(ends[a]->getNextEvent());
+            }
+            delete pairs[p];
+        }
+        delete logged[i]->getLogInfo();
+        delete logged[i];
+    }
+
+    std::set<Anomaly*>::iterator ait;
+    for (ait = anomalies.begin(); ait != anomalies.end(); ait++)
+        delete *ait;
+    std::set<LogEvent*>::iterator eit;
+    for (eit = events.begin(); eit != events.end(); eit++)
+        delete *eit;
+}
+
+//collections own their pair copy and log entries
+void releaseCollections(const std::vector<AnomalyCollection*> &collections)
+{
+    for (size_t i = 0; i < collections.size(); i++)
+    {
+        AnomalyCollection *c = collections[i];
+        std::vector<LoggedAnomaly*> logs = c->getLogs();
+        for (size_t l = 0; l < logs.size(); l++)
+            delete logs[l];
+
+        AnomalyPair *pair = c->getPair();
+        Anomaly *ends[2] = {pair->getPreviousAnomaly(), pair->getNextAnomaly()};
+        for (int a = 0; a < 2; a++)
+        {
+            delete ends[a]->getPreviousEvent();
+            delete ends[a]->getNextEvent();
+            delete ends[a];
+        }
+        delete pair;
+        delete c;
+    }
+}
+
+const char* anomalyTypeName(anomaly_type_t type)
+{
+    switch (type)
+    {
+        case BACKWARD_JUMP_ANOMALY: return "backward_jump";
+        case FORWARD_JUMP_ANOMALY: return "forward_jump";
+        case RECORD_GAP_ANOMALY: return "record_gap";
+        case TIME_DIVERGENCE_ANOMALY: return "time_divergence";
+        case RATE_CHANGE_ANOMALY: return "rate_change";
+        case CLOCK_EVENT_ANOMALY: return "clock_event";
+    }
+    return "unknown";
+}
+
+std::vector<AnomalyPair*> getPairs(std::vector<Anomaly*> anomalies)
+{
+    ScopedPhase phase(PHASE_DETECT);
+    std::vector<AnomalyPair*> pairs;
+
+    if (anomalies.size() > 0)
+    {
+        Anomaly* previous = anomalies[0];
+        for (int i = 1; i < anomalies.size(); i++)
+        {
+            Anomaly* next = anomalies[i];
+            if(previous->getType() != next->getType())
+            {
+                pairs.push_back(
+                        new AnomalyPair(
+                            new Anomaly(previous),
+                            new Anomaly(next)));
+            }
+
+            //make previous
+            previous = next;
+        }
+    }
+
+    return pairs;
+}
+
+/*
+ * Group the pairs of all logs into collections, each pair joining the
+ * first collection it intersects.
+ */
+std::vector<AnomalyCollection*> collectAnomalies(
+        const std::vector<LoggedAnomalies*> &logged)
+{
+    std::vector<AnomalyCollection*> collections;
+    for (int i = 0; i < logged.size(); i++)
+    {
+        std::vector<AnomalyPair*> pairs = logged[i]->getPairs();
+        for (int p = 0; p < pairs.size(); p++)
+        {
+
+            bool found = false;
+
+            for (int a = 0; a < collections.size(); a++)
+            {
+                if (pairs[p]->intersects(collections[a]->getPair()))
+                {
+                    collections[a]->addLog(new LoggedAnomaly(
+                                logged[i]->getLogInfo(), pairs[p]));
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found)
+            {
+                //the collection widens its own copy of the first pair
+                AnomalyCollection *c = new AnomalyCollection();
+                c->setPair(pairs[p]->copy());
+                c->addLog(new LoggedAnomaly(logged[i]->getLogInfo(),
+                            pairs[p]));
+                collections.push_back(c);
+            }
+
+        }
+    }
+    return collections;
+}
+
+//pairs copy the anomalies they keep but share their events
+void releaseAnomalies(const std::vector<Anomaly*> &anomalies,
+        const std::vector<AnomalyPair*> &pairs)
+{
+    std::set<LogEvent*> kept;
+    for (size_t p = 0; p < pairs.size(); p++)
+    {
+        kept.insert(pairs[p]->getPreviousAnomaly()->getPreviousEvent());
+        kept.insert(pairs[p]->getPreviousAnomaly()->getNextEvent());
+        kept.insert(pairs[p]->getNextAnomaly()->getPreviousEvent());
+        kept.insert(pairs[p]->getNextAnomaly()->getNextEvent());
+    }
+
+    for (size_t a = 0; a < anomalies.size(); a++)
+    {
+        if (kept.find(anomalies[a]->getPreviousEvent()) == kept.end())
+            delete anomalies[a]->getPreviousEvent();
+        if (kept.find(anomalies[a]->getNextEvent()) == kept.end())
+            delete anomalies[a]->getNextEvent();
+        delete anomalies[a];
+    }
 }
@@ -18,17 +18,59 @@
 #ifndef ANOMALY_H
 #define ANOMALY_H
 
+#include <stdio.h>
 #include "ILogParser.h"
+#include "PathPool.h"
 
 #define FORWARD_JUMP_DELTA      3600
 #define BACKWARD_JUMP_DELTA     300
 
-enum anomaly_type_t { BACKWARD_JUMP_ANOMALY, FORWARD_JUMP_ANOMALY };
+enum anomaly_type_t {
+    BACKWARD_JUMP_ANOMALY,
+    FORWARD_JUMP_ANOMALY,
+    RECORD_GAP_ANOMALY,
+    TIME_DIVERGENCE_ANOMALY,
+    RATE_CHANGE_ANOMALY,
+    CLOCK_EVENT_ANOMALY
+};
+
+//seconds the clock has to jump between two events to be an anomaly
+struct jump_thresholds
+{
+    int forward;
+    int backward;
+
+    jump_thresholds(int f = FORWARD_JUMP_DELTA, int b = BACKWARD_JUMP_DELTA) :
+        forward(f), backward(b) {}
+};
+
+class MemoryBudget;
+class FileSummary;
+class FileHasher;
+class FileExporter;
+struct file_digests;
 
 struct file_info
 {
     std::string path;
     std::string name;
+    std::string volume;
+    //the file system and inode it was matched in
+    TSK_OFF_T fsOffset;
+    TSK_INUM_T inum;
+    //its content's hashes, when they were asked for and could be read
+    const file_digests *digests;
+};
+
+//a matched file as held by a collection, its strings in the collection's
+//PathPool
+struct file_ref
+{
+    TSK_OFF_T fsOffset;
+    TSK_INUM_T inum;
+    string_id path;
+    string_id name;
+    string_id volume;
 };
 
 class Anomaly
@@ -64,6 +106,7 @@ class AnomalyPair
         AnomalyPair(Anomaly* previous, Anomaly* next) :
             m_previous(previous), m_next(next) {};
         bool intersects(AnomalyPair *pair);
+        AnomalyPair* copy();
 };
 
 class LoggedAnomalies
@@ -96,15 +139,57 @@ class AnomalyCollection
     private:
         AnomalyPair *m_pair;
         std::vector<LoggedAnomaly*> m_logs;
-        std::vector<file_info*> m_files;
+        std::vector<file_ref> m_files;
+        PathPool m_paths;
+        MemoryBudget *m_budget;
+        std::vector<FILE*> m_runs;
+        size_t m_spilled;
+        FileSummary *m_summary;
+        FileHasher *m_hasher;
+        FileExporter *m_exporter;
+
+        void spillFiles();
+        void mergeRuns();
     public:
-        AnomalyCollection() {};
+        AnomalyCollection() :
+            m_budget(NULL), m_spilled(0),
+            m_summary(NULL), m_hasher(NULL), m_exporter(NULL) {};
+        ~AnomalyCollection();
         void setPair(AnomalyPair *pair) { m_pair = pair; };
         AnomalyPair* getPair() { return m_pair; }
         void addLog(LoggedAnomaly* log);
         std::vector<LoggedAnomaly*> getLogs() { return m_logs; };
-        std::vector<file_info*> getFiles() { return m_files; };
-        void addFile(file_info* file);
+        size_t getLogCount();
+        //the matches still in memory; FileMerge reads them all
+        std::vector<file_ref> getFiles() { return m_files; };
+        std::vector<FILE*> getRuns() { return m_runs; }
+        size_t getFileCount() { return m_files.size() + m_spilled; }
+        void addFile(TSK_OFF_T fsOffset, TSK_INUM_T inum,
+                const char *volume, const char *path, const char *name);
+        //where the strings of the matches still in memory are interned
+        PathPool* getPaths() { return &m_paths; }
+        void setBudget(MemoryBudget *budget) { m_budget = budget; }
+        //with a summary, matching files are counted there, not listed;
+        //the collection takes ownership
+        FileSummary* getSummary() { return m_summary; }
+        void setSummary(FileSummary *summary) { m_summary = summary; }
+        //with a hasher, matching files are queued there to be hashed
+        FileHasher* getHasher() { return m_hasher; }
+        void setHasher(FileHasher *hasher) { m_hasher = hasher; }
+        //with an exporter, matching files are queued there to be copied
+        FileExporter* getExporter() { return m_exporter; }
+        void setExporter(FileExporter *exporter) { m_exporter = exporter; }
+        bool contains(time_t t);
+        void getWindow(time_t &start, time_t &end);
 };
 
+const char* anomalyTypeName(anomaly_type_t type);
+std::vector<AnomalyPair*> getPairs(std::vector<Anomaly*> anomalies);
+std::vector<AnomalyCollection*> collectAnomalies(
+        const std::vector<LoggedAnomalies*> &logged);
+void releaseAnomalies(const std::vector<Anomaly*> &anomalies,
+        const std::vector<AnomalyPair*> &pairs);
+void releaseLoggedAnomalies(const std::vector<LoggedAnomalies*> &logged);
+void releaseCollections(const std::vector<AnomalyCollection*> &collections);
+
 #endif
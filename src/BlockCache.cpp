@@ -0,0 +1,240 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BlockCache.h"
+#include <string.h>
+#include "Stats.h"
+
+BlockCache::BlockCache(TSK_FS_FILE *file, size_t blockSize, size_t capacity,
+        const char *name)
+    : m_file(file), m_data(NULL), m_dataSize(0), m_name(name),
+    m_blockSize(blockSize), m_capacity(capacity), m_hits(0), m_misses(0),
+    m_hashing(false), m_hashed(0)
+{
+}
+
+BlockCache::BlockCache(const char *data, size_t size, const char *name)
+    : m_file(NULL), m_data(data), m_dataSize(size), m_name(name),
+    m_blockSize(DEFAULT_CACHE_BLOCK_SIZE), m_capacity(0),
+    m_hits(0), m_misses(0), m_hashing(false), m_hashed(0)
+{
+}
+
+BlockCache::~BlockCache()
+{
+    while (m_lru.size() > 0)
+    {
+        delete m_lru.back();
+        m_lru.pop_back();
+    }
+}
+
+BlockCache::cache_block*
+BlockCache::getBlock(TSK_OFF_T index)
+{
+    std::map<TSK_OFF_T, lru_list::iterator>::iterator it =
+        m_index.find(index);
+    if (it != m_index.end())
+    {
+        m_hits++;
+        Stats::addCacheHit();
+        //move to the front of the LRU list
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return *(it->second);
+    }
+
+    m_misses++;
+    Stats::addCacheMiss();
+
+    cache_block *block;
+    if (m_lru.size() >= m_capacity)
+    {
+        //recycle the least recently used block
+        block = m_lru.back();
+        m_lru.pop_back();
+        m_index.erase(block->index);
+    }
+    else
+    {
+        block = new cache_block;
+        block->data.resize(m_blockSize);
+    }
+
+    ssize_t read = countedFileRead(m_file, index * m_blockSize,
+            &block->data[0], m_blockSize, TSK_FS_FILE_READ_FLAG_NONE);
+    if (read <= 0)
+    {
+        delete block;
+        return NULL;
+    }
+
+    block->index = index;
+    block->length = read;
+    m_lru.push_front(block);
+    m_index[index] = m_lru.begin();
+
+    return block;
+}
+
+ssize_t
+BlockCache::read(TSK_OFF_T offset, char *buf, size_t len)
+{
+    if (m_data)
+    {
+        if (offset < 0 || offset >= (TSK_OFF_T)m_dataSize)
+            return -1;
+        if (len > m_dataSize - offset)
+            len = m_dataSize - offset;
+        memcpy(buf, m_data + offset, len);
+        Stats::addRead(len);
+        hashRead(offset, buf, len);
+        return len;
+    }
+
+    //large reads would only thrash the cache
+    if (m_capacity == 0 || len >= m_blockSize * m_capacity)
+    {
+        ssize_t read = countedFileRead(m_file, offset, buf, len,
+                TSK_FS_FILE_READ_FLAG_NONE);
+        if (read > 0)
+            hashRead(offset, buf, read);
+        return read;
+    }
+
+    if (offset < 0 || offset >= getSize())
+        return -1;
+
+    size_t copied = 0;
+    while (copied < len)
+    {
+        TSK_OFF_T index = offset / m_blockSize;
+        cache_block *block = getBlock(index);
+        if (block == NULL)
+            return copied > 0 ? (ssize_t)copied : -1;
+        if (m_hashing)
+        {
+            hashRead(index * m_blockSize, &block->data[0], block->length);
+            hashCached();
+        }
+
+        size_t within = offset - index * m_blockSize;
+        if (within >= block->length)
+            break;
+
+        size_t count = block->length - within;
+        if (count > len - copied)
+            count = len - copied;
+        memcpy(buf + copied, &block->data[within], count);
+        copied += count;
+        offset += count;
+
+        //a short block is the end of the file
+        if (block->length < m_blockSize)
+            break;
+    }
+
+    return copied;
+}
+
+//extend the content hash with whatever part of a read follows its end
+void
+BlockCache::hashRead(TSK_OFF_T offset, const char *data, size_t length)
+{
+    if (!m_hashing || offset > m_hashed ||
+            offset + (TSK_OFF_T)length <= m_hashed)
+        return;
+
+    ScopedPhase phase(PHASE_CRC);
+    size_t skip = m_hashed - offset;
+    m_sha.update(data + skip, length - skip);
+    m_hashed += length - skip;
+}
+
+//blocks read ahead of the hash are taken in while they are still cached
+void
+BlockCache::hashCached()
+{
+    for (;;)
+    {
+        TSK_OFF_T index = m_hashed / m_blockSize;
+        std::map<TSK_OFF_T, lru_list::iterator>::iterator it =
+            m_index.find(index);
+        if (it == m_index.end())
+            return;
+
+        TSK_OFF_T before = m_hashed;
+        cache_block *block = *(it->second);
+        hashRead(index * m_blockSize, &block->data[0], block->length);
+        if (m_hashed == before)
+            return;
+    }
+}
+
+/*
+ * Start a SHA-256 of the whole content, fed by the reads the parser
+ * makes, and give the SHA-256 of the first block alone in head. The
+ * head is a cheap key for finding possible copies. Returns false if
+ * the first block cannot be read.
+ */
+bool
+BlockCache::startHash(uint8_t head[SHA256_SIZE])
+{
+    m_hashing = true;
+    m_hashed = 0;
+    m_sha = Sha256();
+
+    TSK_OFF_T size = getSize();
+    std::vector<char> buf(m_blockSize);
+    size_t length = size < (TSK_OFF_T)m_blockSize ? size : m_blockSize;
+    ssize_t read = length > 0 ? this->read(0, &buf[0], length) : 0;
+    if (read < (ssize_t)length)
+        return false;
+
+    ScopedPhase phase(PHASE_CRC);
+    Sha256 sha;
+    sha.update(&buf[0], length);
+    sha.final(head);
+    return true;
+}
+
+/*
+ * Complete the content hash started by startHash(), reading what the
+ * parser left out through the cache within its capacity. Returns false
+ * if the file cannot be read to its end.
+ */
+bool
+BlockCache::finishHash(uint8_t digest[SHA256_SIZE])
+{
+    if (!m_hashing)
+        return false;
+
+    TSK_OFF_T size = getSize();
+    std::vector<char> buf(m_blockSize);
+    while (m_hashed < size)
+    {
+        TSK_OFF_T before = m_hashed;
+        size_t length = m_blockSize;
+        if (size - m_hashed < (TSK_OFF_T)length)
+            length = size - m_hashed;
+        if (read(m_hashed, &buf[0], length) <= 0 || m_hashed == before)
+            return false;
+    }
+
+    m_hashing = false;
+    m_sha.final(digest);
+    return true;
+}
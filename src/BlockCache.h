@@ -0,0 +1,86 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <tsk3/libtsk.h>
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <vector>
+#include "Digest.h"
+
+#define DEFAULT_CACHE_BLOCK_SIZE    65536
+#define DEFAULT_CACHE_BLOCKS        32
+
+/*
+ * Read-through LRU cache of aligned blocks in front of tsk_fs_file_read().
+ * The parsers issue many small, overlapping reads at nearby offsets;
+ * this turns them into a few large aligned reads of the underlying file.
+ * A capacity of zero blocks passes every read straight through. Logs
+ * held in memory are read directly from the caller's buffer.
+ */
+class BlockCache
+{
+    private:
+        struct cache_block
+        {
+            TSK_OFF_T index;
+            size_t length;
+            std::vector<char> data;
+        };
+        typedef std::list<cache_block*> lru_list;
+
+        TSK_FS_FILE *m_file;
+        const char *m_data;
+        size_t m_dataSize;
+        const char *m_name;
+        size_t m_blockSize;
+        size_t m_capacity;
+        lru_list m_lru;
+        std::map<TSK_OFF_T, lru_list::iterator> m_index;
+        uint64_t m_hits;
+        uint64_t m_misses;
+        //content hash fed by the reads as they reach its end
+        bool m_hashing;
+        Sha256 m_sha;
+        TSK_OFF_T m_hashed;
+
+        cache_block* getBlock(TSK_OFF_T index);
+        void hashRead(TSK_OFF_T offset, const char *data, size_t length);
+        void hashCached();
+    public:
+        BlockCache(TSK_FS_FILE *file,
+                size_t blockSize = DEFAULT_CACHE_BLOCK_SIZE,
+                size_t capacity = DEFAULT_CACHE_BLOCKS,
+                const char *name = NULL);
+        BlockCache(const char *data, size_t size, const char *name);
+        ~BlockCache();
+        ssize_t read(TSK_OFF_T offset, char *buf, size_t len);
+        bool startHash(uint8_t head[SHA256_SIZE]);
+        bool finishHash(uint8_t digest[SHA256_SIZE]);
+        TSK_FS_FILE* getFile() { return m_file; }
+        TSK_OFF_T getSize()
+            { return m_file ? m_file->meta->size : (TSK_OFF_T)m_dataSize; }
+        //files opened by address have no name of their own
+        const char* getName() { return m_name ? m_name : m_file->name->name; }
+        uint64_t getHits() { return m_hits; }
+        uint64_t getMisses() { return m_misses; }
+};
+
+#endif
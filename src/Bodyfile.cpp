@@ -0,0 +1,227 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include "Bodyfile.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+struct bodyfile_buffer
+{
+    bodyfile_buffer *next;
+    size_t used;
+    char data[BODYFILE_BUFFER];
+};
+
+//which writer the calling thread's buffer belongs to; a generation
+//rather than a pointer so a new writer at the same address gets its own
+static unsigned s_generations = 0;
+static __thread unsigned s_generation = 0;
+static __thread bodyfile_buffer *s_buffer = NULL;
+
+BodyfileWriter::BodyfileWriter() :
+    m_fd(-1), m_generation(__sync_add_and_fetch(&s_generations, 1)),
+    m_buffers(NULL), m_failed(false)
+{
+}
+
+BodyfileWriter::~BodyfileWriter()
+{
+    close();
+}
+
+bool
+BodyfileWriter::open(const char *path)
+{
+    m_fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    return m_fd >= 0;
+}
+
+/*
+ * The calling thread's buffer, registered on first use with a
+ * compare-and-swap onto the writer's list.
+ */
+bodyfile_buffer*
+BodyfileWriter::threadBuffer()
+{
+    if (s_generation == m_generation)
+        return s_buffer;
+
+    bodyfile_buffer *buffer = new bodyfile_buffer;
+    buffer->used = 0;
+    do
+        buffer->next = m_buffers;
+    while (!__sync_bool_compare_and_swap(&m_buffers, buffer->next, buffer));
+
+    s_buffer = buffer;
+    s_generation = m_generation;
+    return buffer;
+}
+
+//whole lines per write(), so lines of different threads never mix
+void
+BodyfileWriter::writeOut(const char *data, size_t length)
+{
+    size_t done = 0;
+    while (done < length)
+    {
+        ssize_t written = write(m_fd, data + done, length - done);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+        {
+            m_failed = true;
+            break;
+        }
+        done += written;
+    }
+}
+
+void
+BodyfileWriter::append(const char *line, size_t length)
+{
+    bodyfile_buffer *buffer = threadBuffer();
+    if (buffer->used + length > BODYFILE_BUFFER)
+    {
+        writeOut(buffer->data, buffer->used);
+        buffer->used = 0;
+    }
+    if (length > BODYFILE_BUFFER)
+    {
+        writeOut(line, length);
+        return;
+    }
+    memcpy(buffer->data + buffer->used, line, length);
+    buffer->used += length;
+}
+
+void
+BodyfileWriter::writeLine(const std::string &volume, const char *path,
+        const char *name, const char *inode, const char *mode,
+        unsigned uid, unsigned gid, uint64_t size, time_t atime,
+        time_t mtime, time_t ctime, time_t crtime)
+{
+    if (m_fd < 0)
+        return;
+
+    //named as the report names files, rooted like fls names them
+    const char *volumeOpen = volume.empty() ? "" : "[";
+    const char *volumeClose = volume.empty() ? "" : "] ";
+    const char *root = path[0] == '/' ? "" : "/";
+    const char *format =
+        "0|%s%s%s%s%s%s|%s|%s|%u|%u|%llu|%lld|%lld|%lld|%lld\n";
+
+    char line[1024];
+    int length = snprintf(line, sizeof(line), format, volumeOpen,
+            volume.c_str(), volumeClose, root, path, name, inode, mode, uid,
+            gid, (unsigned long long)size, (long long)atime,
+            (long long)mtime, (long long)ctime, (long long)crtime);
+    if (length < 0)
+        return;
+    if ((size_t)length < sizeof(line))
+    {
+        append(line, length);
+        return;
+    }
+
+    std::vector<char> longer(length + 1);
+    snprintf(&longer[0], longer.size(), format, volumeOpen, volume.c_str(),
+            volumeClose, root, path, name, inode, mode, uid, gid,
+            (unsigned long long)size, (long long)atime, (long long)mtime,
+            (long long)ctime, (long long)crtime);
+    append(&longer[0], length);
+}
+
+void
+BodyfileWriter::addFile(const std::string &volume, const char *path,
+        TSK_FS_FILE *fs_file)
+{
+    TSK_FS_META *meta = fs_file->meta;
+    char inode[32];
+    snprintf(inode, sizeof(inode), "%llu",
+            (unsigned long long)fs_file->name->meta_addr);
+
+    //mode as fls writes it: name type, then the metadata's type and bits
+    char mode[16];
+    unsigned type = fs_file->name->type;
+    if (type >= TSK_FS_NAME_TYPE_STR_MAX)
+        type = 0;
+    snprintf(mode, sizeof(mode), "%s/", tsk_fs_name_type_str[type]);
+#ifdef HAVE_TSK_FS_META_MAKE_LS
+    if (meta)
+        tsk_fs_meta_make_ls(meta, mode + strlen(mode),
+                sizeof(mode) - strlen(mode));
+    else
+#endif
+        strcat(mode, "----------");
+
+    if (meta)
+        writeLine(volume, path, fs_file->name->name, inode, mode, meta->uid,
+                meta->gid, meta->size, meta->atime, meta->mtime, meta->ctime,
+                meta->crtime);
+    else
+        writeLine(volume, path, fs_file->name->name, inode, mode, 0, 0, 0,
+                0, 0, 0, 0);
+}
+
+void
+BodyfileWriter::addRecord(const std::string &volume, const std::string &path,
+        const std::string &name, uint64_t record, bool directory,
+        time_t atime, time_t mtime, time_t ctime, time_t crtime)
+{
+    char inode[32];
+    snprintf(inode, sizeof(inode), "%llu", (unsigned long long)record);
+    writeLine(volume, path.c_str(), name.c_str(), inode,
+            directory ? "d/drwxrwxrwx" : "r/rrwxrwxrwx", 0, 0, 0, atime,
+            mtime, ctime, crtime);
+}
+
+void
+BodyfileWriter::addEvent(const std::string &volume, const char *path,
+        const char *name, LogEvent *event)
+{
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), " (record %d, event %d)",
+            event->getEventId(), event->getEventCode());
+    std::string record = std::string(name) + suffix;
+    writeLine(volume, path, record.c_str(), "0", "-/----------", 0, 0, 0, 0,
+            event->getDateWritten(), 0, event->getDateCreated());
+}
+
+bool
+BodyfileWriter::close()
+{
+    while (m_buffers)
+    {
+        bodyfile_buffer *buffer = m_buffers;
+        m_buffers = buffer->next;
+        if (m_fd >= 0)
+            writeOut(buffer->data, buffer->used);
+        delete buffer;
+    }
+    if (m_fd >= 0 && ::close(m_fd) != 0)
+        m_failed = true;
+    m_fd = -1;
+
+    //the buffers threads still point at are gone
+    m_generation = __sync_add_and_fetch(&s_generations, 1);
+    return !m_failed;
+}
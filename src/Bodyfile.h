@@ -0,0 +1,76 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BODYFILE_H
+#define BODYFILE_H
+
+#include <tsk3/libtsk.h>
+#include <string>
+#include "ILogParser.h"
+
+//bytes each thread formats before handing them to the file
+#define BODYFILE_BUFFER     (256 * 1024)
+
+struct bodyfile_buffer;
+
+/*
+ * Streams a timeline in the bodyfile format mactime reads, one line per
+ * file the scan visits and per log event the parsers keep. Copies of a
+ * log already parsed and events outside the time window get no line:
+ *
+ *   MD5|name|inode|mode|UID|GID|size|atime|mtime|ctime|crtime
+ *
+ * Every thread formats lines into a buffer of its own and appends it to
+ * the file with one write() when it fills, so the scanning threads never
+ * wait on one another. Lines come out in no particular order; mactime
+ * sorts them. Buffers are only written out in full by close(), which
+ * must not race with the threads still adding lines.
+ */
+class BodyfileWriter
+{
+    private:
+        int m_fd;
+        unsigned m_generation;
+        bodyfile_buffer *m_buffers;
+        bool m_failed;
+
+        bodyfile_buffer* threadBuffer();
+        void append(const char *line, size_t length);
+        void writeOut(const char *data, size_t length);
+        void writeLine(const std::string &volume, const char *path,
+                const char *name, const char *inode, const char *mode,
+                unsigned uid, unsigned gid, uint64_t size, time_t atime,
+                time_t mtime, time_t ctime, time_t crtime);
+    public:
+        BodyfileWriter();
+        ~BodyfileWriter();
+        bool open(const char *path);
+        bool isOpen() { return m_fd >= 0; }
+        void addFile(const std::string &volume, const char *path,
+                TSK_FS_FILE *fs_file);
+        //an NTFS record's $STANDARD_INFORMATION or $FILE_NAME times
+        void addRecord(const std::string &volume, const std::string &path,
+                const std::string &name, uint64_t record, bool directory,
+                time_t atime, time_t mtime, time_t ctime, time_t crtime);
+        //the written time goes in mtime and the created time in crtime
+        void addEvent(const std::string &volume, const char *path,
+                const char *name, LogEvent *event);
+        //false if any line could not be written
+        bool close();
+};
+
+#endif
@@ -0,0 +1,866 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Daemon.h"
+#include <errno.h>
+#include <limits.h>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "Digest.h"
+#include "Trace.h"
+#include "exceptions/Exception.h"
+
+enum json_kind_t {JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY};
+
+struct json_value
+{
+    json_kind_t kind;
+    bool flag;
+    std::string text;
+    std::vector<std::string> list;
+};
+
+static void skipSpace(const std::string &s, size_t &pos)
+{
+    while (pos < s.length() && (s[pos] == ' ' || s[pos] == '\t' ||
+                s[pos] == '\r' || s[pos] == '\n'))
+        pos++;
+}
+
+static void appendUtf8(std::string &out, unsigned code)
+{
+    if (code < 0x80)
+        out += (char)code;
+    else if (code < 0x800)
+    {
+        out += (char)(0xC0 | (code >> 6));
+        out += (char)(0x80 | (code & 0x3F));
+    }
+    else
+    {
+        out += (char)(0xE0 | (code >> 12));
+        out += (char)(0x80 | ((code >> 6) & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    }
+}
+
+static bool parseString(const std::string &s, size_t &pos, std::string &out)
+{
+    if (pos >= s.length() || s[pos] != '"')
+        return false;
+    pos++;
+
+    out.clear();
+    while (pos < s.length() && s[pos] != '"')
+    {
+        char c = s[pos++];
+        if (c != '\\')
+        {
+            out += c;
+            continue;
+        }
+        if (pos >= s.length())
+            return false;
+
+        c = s[pos++];
+        switch (c)
+        {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u':
+                if (pos + 4 > s.length())
+                    return false;
+                appendUtf8(out, strtoul(s.substr(pos, 4).c_str(), NULL, 16));
+                pos += 4;
+                break;
+            default: out += c; break;
+        }
+    }
+    if (pos >= s.length())
+        return false;
+    pos++;
+
+    return true;
+}
+
+//values are limited to what requests use: scalars and arrays of strings
+static bool parseValue(const std::string &s, size_t &pos, json_value &value)
+{
+    skipSpace(s, pos);
+    if (pos >= s.length())
+        return false;
+
+    value.list.clear();
+    if (s[pos] == '"')
+    {
+        value.kind = JSON_STRING;
+        return parseString(s, pos, value.text);
+    }
+    else if (s[pos] == '[')
+    {
+        value.kind = JSON_ARRAY;
+        pos++;
+        skipSpace(s, pos);
+        if (pos < s.length() && s[pos] == ']')
+        {
+            pos++;
+            return true;
+        }
+        for (;;)
+        {
+            std::string item;
+            skipSpace(s, pos);
+            if (!parseString(s, pos, item))
+                return false;
+            value.list.push_back(item);
+            skipSpace(s, pos);
+            if (pos < s.length() && s[pos] == ',')
+                pos++;
+            else if (pos < s.length() && s[pos] == ']')
+            {
+                pos++;
+                return true;
+            }
+            else
+                return false;
+        }
+    }
+    else if (s.compare(pos, 4, "true") == 0 || s.compare(pos, 5, "false") == 0)
+    {
+        value.kind = JSON_BOOL;
+        value.flag = (s[pos] == 't');
+        pos += value.flag ? 4 : 5;
+        return true;
+    }
+    else if (s.compare(pos, 4, "null") == 0)
+    {
+        value.kind = JSON_NULL;
+        pos += 4;
+        return true;
+    }
+
+    size_t start = pos;
+    while (pos < s.length() && strchr("+-0123456789.eE", s[pos]))
+        pos++;
+    value.kind = JSON_NUMBER;
+    value.text = s.substr(start, pos - start);
+    return pos > start;
+}
+
+static bool parseRequest(const std::string &line, daemon_request &request,
+        std::string &error)
+{
+    request.type = "analyze";
+    request.files = false;
+    request.partitions = false;
+    request.sniff = false;
+    request.correlate = false;
+    request.mftScan = false;
+    request.parallelWalk = false;
+    request.since = 0;
+    request.until = 0;
+
+    size_t pos = 0;
+    skipSpace(line, pos);
+    if (pos >= line.length() || line[pos] != '{')
+    {
+        error = "request is not a JSON object";
+        return false;
+    }
+    pos++;
+
+    skipSpace(line, pos);
+    if (pos < line.length() && line[pos] == '}')
+        return true;
+
+    for (;;)
+    {
+        std::string key;
+        json_value value;
+        skipSpace(line, pos);
+        if (!parseString(line, pos, key))
+        {
+            error = "expected a key";
+            return false;
+        }
+        skipSpace(line, pos);
+        if (pos >= line.length() || line[pos++] != ':' ||
+                !parseValue(line, pos, value))
+        {
+            error = "malformed value for " + key;
+            return false;
+        }
+
+        if (key == "id" || key == "type" || key == "imgtype")
+        {
+            if (value.kind != JSON_STRING)
+            {
+                error = key + " must be a string";
+                return false;
+            }
+            if (key == "id")
+                request.id = value.text;
+            else if (key == "type")
+                request.type = value.text;
+            else
+                request.imgtype = value.text;
+        }
+        else if (key == "images")
+        {
+            if (value.kind != JSON_ARRAY)
+            {
+                error = "images must be an array of paths";
+                return false;
+            }
+            request.images = value.list;
+        }
+        else if (key == "since" || key == "until")
+        {
+            if (value.kind != JSON_NUMBER)
+            {
+                error = key + " must be UNIX seconds";
+                return false;
+            }
+            time_t t = (time_t)strtoll(value.text.c_str(), NULL, 10);
+            if (key == "since")
+                request.since = t;
+            else
+                request.until = t;
+        }
+        else if (key == "forward" || key == "backward")
+        {
+            long seconds = value.kind == JSON_NUMBER ?
+                strtol(value.text.c_str(), NULL, 10) : -1;
+            if (seconds < 0 || seconds > INT_MAX)
+            {
+                error = key + " must be seconds";
+                return false;
+            }
+            if (key == "forward")
+                request.jumps.forward = seconds;
+            else
+                request.jumps.backward = seconds;
+        }
+        else if (value.kind == JSON_BOOL)
+        {
+            if (key == "files")
+                request.files = value.flag;
+            else if (key == "partitions")
+                request.partitions = value.flag;
+            else if (key == "sniff")
+                request.sniff = value.flag;
+            else if (key == "correlate")
+                request.correlate = value.flag;
+            else if (key == "mft")
+                request.mftScan = value.flag;
+            else if (key == "walk")
+                request.parallelWalk = value.flag;
+        }
+
+        skipSpace(line, pos);
+        if (pos < line.length() && line[pos] == ',')
+            pos++;
+        else if (pos < line.length() && line[pos] == '}')
+            return true;
+        else
+        {
+            error = "expected , or }";
+            return false;
+        }
+    }
+}
+
+static void jsonString(std::ostream &out, const std::string &s)
+{
+    out << '"';
+    for (size_t i = 0; i < s.length(); i++)
+    {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (c < 0x20)
+        {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            out << code;
+        }
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+static void jsonTimes(std::ostream &out, const char *name, LogEvent *event)
+{
+    out << ",\"" << name << "\":{\"created\":" << event->getDateCreated()
+        << ",\"written\":" << event->getDateWritten() << "}";
+}
+
+static bool sendLine(int fd, const std::string &line)
+{
+    std::string data = line + "\n";
+    size_t sent = 0;
+    while (sent < data.length())
+    {
+        ssize_t n = send(fd, data.data() + sent, data.length() - sent,
+                MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+static void sendError(int fd, const std::string &id, const std::string &message)
+{
+    std::ostringstream line;
+    line << "{\"id\":";
+    jsonString(line, id);
+    line << ",\"type\":\"error\",\"message\":";
+    jsonString(line, message);
+    line << "}";
+    sendLine(fd, line.str());
+}
+
+/*
+ * Identify an image by what would change its log results: the paths,
+ * their sizes and modification times, and the log options.
+ */
+static bool cacheKey(const daemon_request &request, std::string &key)
+{
+    std::ostringstream out;
+    for (size_t i = 0; i < request.images.size(); i++)
+    {
+        struct stat st;
+        if (stat(request.images[i].c_str(), &st) != 0)
+            return false;
+        out << request.images[i] << '\0' << st.st_size << '\0'
+            << st.st_mtime << '\0';
+    }
+    out << request.imgtype << '\0' << request.partitions << request.sniff
+        << request.correlate << '\0' << request.since << '\0'
+        << request.until << '\0' << request.jumps.forward << '\0'
+        << request.jumps.backward;
+    key = out.str();
+    return true;
+}
+
+static double elapsed(const struct timespec &start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+Daemon::Daemon(const char *path, const tadpole_config &config) :
+    m_path(path), m_listen(-1), m_stop(false), m_config(config),
+    m_tick(0), m_hits(0), m_misses(0)
+{
+    //0 threads is one per CPU
+    if (m_config.threads == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        m_config.threads = cpus > 0 ? cpus : 1;
+    }
+
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_ready, NULL);
+}
+
+Daemon::~Daemon()
+{
+    std::map<std::string, daemon_results*>::iterator it;
+    for (it = m_cache.begin(); it != m_cache.end(); it++)
+    {
+        releaseLoggedAnomalies(it->second->logged);
+        delete it->second;
+    }
+    pthread_cond_destroy(&m_ready);
+    pthread_mutex_destroy(&m_lock);
+}
+
+daemon_results*
+Daemon::acquire(const std::string &key)
+{
+    daemon_results *results = NULL;
+
+    pthread_mutex_lock(&m_lock);
+    std::map<std::string, daemon_results*>::iterator it = m_cache.find(key);
+    if (it != m_cache.end())
+    {
+        results = it->second;
+        results->refs++;
+        results->used = ++m_tick;
+        m_hits++;
+    }
+    else
+        m_misses++;
+    pthread_mutex_unlock(&m_lock);
+
+    return results;
+}
+
+/*
+ * Cache freshly scanned results and return them referenced. The least
+ * recently used entry makes room; it is freed once its last request is
+ * done with it.
+ */
+daemon_results*
+Daemon::store(const std::string &key,
+        const std::vector<LoggedAnomalies*> &logged)
+{
+    pthread_mutex_lock(&m_lock);
+
+    std::map<std::string, daemon_results*>::iterator it = m_cache.find(key);
+    if (it != m_cache.end())
+    {
+        //another request scanned the same image meanwhile
+        daemon_results *existing = it->second;
+        existing->refs++;
+        existing->used = ++m_tick;
+        pthread_mutex_unlock(&m_lock);
+        releaseLoggedAnomalies(logged);
+        return existing;
+    }
+
+    if (m_cache.size() >= DAEMON_CACHE_ENTRIES)
+    {
+        std::map<std::string, daemon_results*>::iterator oldest = m_cache.begin();
+        for (it = m_cache.begin(); it != m_cache.end(); it++)
+            if (it->second->used < oldest->second->used)
+                oldest = it;
+        daemon_results *evicted = oldest->second;
+        m_cache.erase(oldest);
+        evicted->evicted = true;
+        if (evicted->refs == 0)
+        {
+            releaseLoggedAnomalies(evicted->logged);
+            delete evicted;
+        }
+    }
+
+    daemon_results *results = new daemon_results;
+    results->logged = logged;
+    results->refs = 1;
+    results->used = ++m_tick;
+    results->evicted = false;
+    m_cache[key] = results;
+
+    pthread_mutex_unlock(&m_lock);
+    return results;
+}
+
+void
+Daemon::release(daemon_results *results)
+{
+    pthread_mutex_lock(&m_lock);
+    bool last = (--results->refs == 0 && results->evicted);
+    pthread_mutex_unlock(&m_lock);
+
+    if (last)
+    {
+        releaseLoggedAnomalies(results->logged);
+        delete results;
+    }
+}
+
+void
+Daemon::stop()
+{
+    pthread_mutex_lock(&m_lock);
+    m_stop = true;
+    pthread_cond_broadcast(&m_ready);
+    //idle clients see end of input once their current request is done
+    std::set<int>::iterator it;
+    for (it = m_clients.begin(); it != m_clients.end(); it++)
+        shutdown(*it, SHUT_RD);
+    pthread_mutex_unlock(&m_lock);
+
+    //wakes the accept loop
+    shutdown(m_listen, SHUT_RDWR);
+}
+
+void
+Daemon::handle(int fd, const daemon_request &request)
+{
+    TRACE_SCOPE_FILE("Daemon::request", "", request.id.c_str());
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (request.images.empty())
+    {
+        sendError(fd, request.id, "no images given");
+        return;
+    }
+
+    TSK_IMG_TYPE_ENUM imgtype = TSK_IMG_TYPE_DETECT;
+    if (!request.imgtype.empty())
+    {
+        imgtype = tsk_img_type_toid(request.imgtype.c_str());
+        if (imgtype == TSK_IMG_TYPE_UNSUPP)
+        {
+            sendError(fd, request.id,
+                    "unsupported image type " + request.imgtype);
+            return;
+        }
+    }
+
+    std::string key;
+    if (!cacheKey(request, key))
+    {
+        sendError(fd, request.id, "cannot stat image");
+        return;
+    }
+
+    int count = request.images.size();
+    std::vector<const TSK_TCHAR*> images(count);
+    for (int i = 0; i < count; i++)
+        images[i] = request.images[i].c_str();
+
+    tadpole_config config = m_config;
+    config.processFiles = request.files;
+    config.partitions = request.partitions;
+    config.sniff = request.sniff;
+    config.correlate = request.correlate;
+    config.mftScan = request.mftScan;
+    config.parallelWalk = request.parallelWalk;
+    config.since = request.since;
+    config.until = request.until;
+    config.jumps = request.jumps;
+    //the service always answers in full, without sweeps or early reports
+    config.sweep.clear();
+    config.progressive = false;
+    config.triage = 0;
+    config.deadline = 0;
+    config.summarizeFiles = false;
+    //requests run at once and would write over each other's timelines
+    config.bodyfile.clear();
+    config.exportDir.clear();
+    Analysis analysis(config);
+    analysis.setImages(count, &images[0], imgtype);
+
+    //correlated anomalies are only found by finish(), after the scan
+    //the cache holds, so those requests always scan
+    daemon_results *results = NULL;
+    if (!request.correlate)
+        results = acquire(key);
+    bool cached = (results != NULL);
+    //a parser error must not escape the worker thread
+    try
+    {
+        if (!cached)
+        {
+            if (!analysis.scanLogs())
+            {
+                sendError(fd, request.id, analysis.getError());
+                return;
+            }
+            if (!request.correlate)
+                results = store(key, analysis.takeLoggedAnomalies());
+        }
+        else
+            analysis.addLoggedAnomalies(results->logged);
+
+        if (!analysis.finish())
+        {
+            sendError(fd, request.id, analysis.getError());
+            if (results)
+                release(results);
+            return;
+        }
+    }
+    catch (Exception &e)
+    {
+        sendError(fd, request.id, "unable to parse a log");
+        if (results)
+            release(results);
+        return;
+    }
+
+    std::vector<AnomalyCollection*> collections = analysis.getCollections();
+    bool connected = true;
+    for (size_t i = 0; connected && i < collections.size(); i++)
+    {
+        AnomalyCollection *c = collections[i];
+        std::ostringstream line;
+        line << "{\"id\":";
+        jsonString(line, request.id);
+        line << ",\"type\":\"anomaly\"";
+        jsonTimes(line, "real_start",
+                c->getPair()->getPreviousAnomaly()->getPreviousEvent());
+        jsonTimes(line, "anomaly_start",
+                c->getPair()->getPreviousAnomaly()->getNextEvent());
+        jsonTimes(line, "anomaly_end",
+                c->getPair()->getNextAnomaly()->getPreviousEvent());
+        jsonTimes(line, "real_end",
+                c->getPair()->getNextAnomaly()->getNextEvent());
+
+        line << ",\"logs\":[";
+        std::vector<LoggedAnomaly*> logs = c->getLogs();
+        for (size_t l = 0; l < logs.size(); l++)
+        {
+            line << (l ? "," : "") << "{\"volume\":";
+            jsonString(line, logs[l]->getLogInfo()->getVolume());
+            line << ",\"path\":";
+            jsonString(line, logs[l]->getLogInfo()->getPath());
+            line << ",\"name\":";
+            jsonString(line, logs[l]->getLogInfo()->getName());
+            line << ",\"copies\":[";
+            std::vector<log_location> copies =
+                logs[l]->getLogInfo()->getCopies();
+            for (size_t c = 0; c < copies.size(); c++)
+            {
+                line << (c ? "," : "") << "{\"volume\":";
+                jsonString(line, copies[c].volume);
+                line << ",\"path\":";
+                jsonString(line, copies[c].path);
+                line << ",\"name\":";
+                jsonString(line, copies[c].name);
+                line << "}";
+            }
+            line << "]}";
+        }
+        line << "],\"files\":[";
+        FileMerge files(c);
+        file_info file;
+        for (size_t f = 0; files.next(file); f++)
+        {
+            line << (f ? "," : "") << "{\"volume\":";
+            jsonString(line, file.volume);
+            line << ",\"path\":";
+            jsonString(line, file.path);
+            line << ",\"name\":";
+            jsonString(line, file.name);
+            std::vector<std::pair<const char*, std::string> > digests =
+                listDigests(file.digests);
+            for (size_t d = 0; d < digests.size(); d++)
+                line << ",\"" << digests[d].first << "\":\""
+                    << digests[d].second << "\"";
+            line << "}";
+        }
+        line << "]}";
+        connected = sendLine(fd, line.str());
+    }
+
+    if (connected)
+    {
+        std::ostringstream line;
+        line << "{\"id\":";
+        jsonString(line, request.id);
+        line << ",\"type\":\"done\",\"logs\":"
+            << analysis.getLoggedAnomalies().size()
+            << ",\"collections\":" << collections.size()
+            << ",\"cached\":" << (cached ? "true" : "false")
+            << ",\"seconds\":" << elapsed(start) << "}";
+        sendLine(fd, line.str());
+    }
+
+    if (results)
+        release(results);
+}
+
+/*
+ * Serve requests from one client, in order, until it disconnects.
+ */
+void
+Daemon::serveConnection(int fd)
+{
+    std::string buffer;
+    char data[4096];
+
+    pthread_mutex_lock(&m_lock);
+    m_clients.insert(fd);
+    if (m_stop)
+        shutdown(fd, SHUT_RD);
+    pthread_mutex_unlock(&m_lock);
+
+    for (;;)
+    {
+        size_t newline;
+        while ((newline = buffer.find('\n')) != std::string::npos)
+        {
+            std::string line = buffer.substr(0, newline);
+            buffer.erase(0, newline + 1);
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+
+            daemon_request request;
+            std::string error;
+            //thresholds not given fall back to the service's own
+            request.jumps = m_config.jumps;
+            if (!parseRequest(line, request, error))
+                sendError(fd, request.id, error);
+            else if (request.type == "analyze")
+                handle(fd, request);
+            else if (request.type == "status")
+            {
+                std::ostringstream reply;
+                pthread_mutex_lock(&m_lock);
+                reply << "{\"id\":";
+                jsonString(reply, request.id);
+                reply << ",\"type\":\"status\",\"threads\":" << m_config.threads
+                    << ",\"cached\":" << m_cache.size()
+                    << ",\"hits\":" << m_hits
+                    << ",\"misses\":" << m_misses << "}";
+                pthread_mutex_unlock(&m_lock);
+                sendLine(fd, reply.str());
+            }
+            else if (request.type == "shutdown")
+            {
+                std::ostringstream reply;
+                reply << "{\"id\":";
+                jsonString(reply, request.id);
+                reply << ",\"type\":\"shutdown\"}";
+                sendLine(fd, reply.str());
+                stop();
+            }
+            else
+                sendError(fd, request.id,
+                        "unknown request type " + request.type);
+        }
+
+        ssize_t n = recv(fd, data, sizeof(data), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        buffer.append(data, n);
+    }
+
+    pthread_mutex_lock(&m_lock);
+    m_clients.erase(fd);
+    pthread_mutex_unlock(&m_lock);
+    close(fd);
+}
+
+void*
+Daemon::run(void *arg)
+{
+    Daemon *self = (Daemon*)arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&self->m_lock);
+        while (self->m_connections.empty() && !self->m_stop)
+            pthread_cond_wait(&self->m_ready, &self->m_lock);
+        if (self->m_connections.empty())
+        {
+            pthread_mutex_unlock(&self->m_lock);
+            break;
+        }
+        int fd = self->m_connections.front();
+        self->m_connections.pop_front();
+        pthread_mutex_unlock(&self->m_lock);
+
+        self->serveConnection(fd);
+    }
+
+    return NULL;
+}
+
+/*
+ * Listen until a shutdown request arrives. The socket is only reachable
+ * by the owner. Returns false if the socket could not be set up.
+ */
+bool
+Daemon::serve()
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (m_path.length() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "Socket path too long: " << m_path << std::endl;
+        return false;
+    }
+    strcpy(addr.sun_path, m_path.c_str());
+
+    m_listen = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listen < 0)
+    {
+        std::cerr << "Unable to create socket: " << strerror(errno)
+            << std::endl;
+        return false;
+    }
+
+    unlink(m_path.c_str());
+    mode_t mask = umask(0077);
+    int bound = bind(m_listen, (struct sockaddr*)&addr, sizeof(addr));
+    umask(mask);
+    if (bound != 0 || listen(m_listen, DAEMON_BACKLOG) != 0)
+    {
+        std::cerr << "Unable to listen on " << m_path << ": "
+            << strerror(errno) << std::endl;
+        close(m_listen);
+        return false;
+    }
+
+    std::vector<pthread_t> threads(m_config.threads);
+    std::vector<bool> started(m_config.threads, false);
+    for (unsigned i = 0; i < m_config.threads; i++)
+        started[i] = (pthread_create(&threads[i], NULL, run, this) == 0);
+
+    if (tsk_verbose)
+        std::cerr << "Listening on " << m_path << " with " << m_config.threads
+            << " workers" << std::endl;
+
+    for (;;)
+    {
+        int fd = accept(m_listen, NULL, NULL);
+        if (fd < 0)
+        {
+            if ((errno == EINTR || errno == ECONNABORTED) && !m_stop)
+                continue;
+            break;
+        }
+
+        pthread_mutex_lock(&m_lock);
+        bool stopping = m_stop;
+        if (!stopping)
+        {
+            m_connections.push_back(fd);
+            pthread_cond_signal(&m_ready);
+        }
+        pthread_mutex_unlock(&m_lock);
+        if (stopping)
+        {
+            close(fd);
+            break;
+        }
+    }
+
+    stop();
+    for (unsigned i = 0; i < m_config.threads; i++)
+        if (started[i])
+            pthread_join(threads[i], NULL);
+
+    close(m_listen);
+    unlink(m_path.c_str());
+    return true;
+}
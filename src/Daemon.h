@@ -0,0 +1,99 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <tsk3/libtsk.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "Anomaly.h"
+#include "Tadpole.h"
+
+#define DAEMON_CACHE_ENTRIES    16
+#define DAEMON_BACKLOG          16
+
+struct daemon_request
+{
+    std::string id;
+    std::string type;
+    std::vector<std::string> images;
+    std::string imgtype;
+    bool files;
+    bool partitions;
+    bool sniff;
+    bool correlate;
+    bool mftScan;
+    bool parallelWalk;
+    time_t since;
+    time_t until;
+    jump_thresholds jumps;
+};
+
+//log results of one image, shared by every request that hits the cache
+struct daemon_results
+{
+    std::vector<LoggedAnomalies*> logged;
+    unsigned refs;
+    uint64_t used;
+    bool evicted;
+};
+
+/*
+ * Long-running service mode. Requests arrive as one JSON object per line
+ * on a Unix domain socket and results stream back as NDJSON. Each request
+ * runs an Analysis starting from the configuration the daemon was given.
+ * A fixed pool of workers serves connections, and the log results of each
+ * image are cached, keyed by path, size and modification time along with
+ * the options that shape them, so repeat requests skip the log scan.
+ */
+class Daemon
+{
+    private:
+        std::string m_path;
+        int m_listen;
+        bool m_stop;
+        tadpole_config m_config;
+        pthread_mutex_t m_lock;
+        pthread_cond_t m_ready;
+        std::deque<int> m_connections;
+        std::set<int> m_clients;
+        std::map<std::string, daemon_results*> m_cache;
+        uint64_t m_tick;
+        uint64_t m_hits;
+        uint64_t m_misses;
+
+        static void* run(void *arg);
+        void serveConnection(int fd);
+        void handle(int fd, const daemon_request &request);
+        daemon_results* acquire(const std::string &key);
+        daemon_results* store(const std::string &key,
+                const std::vector<LoggedAnomalies*> &logged);
+        void release(daemon_results *results);
+        void stop();
+    public:
+        Daemon(const char *path, const tadpole_config &config);
+        ~Daemon();
+        bool serve();
+};
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Deadline.h"
+#include <time.h>
+
+scan_coverage::scan_coverage() :
+    logsFound(0), logsParsed(0), logsSkipped(0), bytesParsed(0),
+    bytesSkipped(0), walkComplete(true), filesScanned(0),
+    filesComplete(true)
+{
+}
+
+void
+scan_coverage::add(const scan_coverage &other)
+{
+    logsFound += other.logsFound;
+    logsParsed += other.logsParsed;
+    logsSkipped += other.logsSkipped;
+    bytesParsed += other.bytesParsed;
+    bytesSkipped += other.bytesSkipped;
+    walkComplete = walkComplete && other.walkComplete;
+    filesScanned += other.filesScanned;
+    filesComplete = filesComplete && other.filesComplete;
+}
+
+uint64_t
+monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void
+Deadline::start(unsigned seconds)
+{
+    m_start = monotonicNs();
+    m_budget = (uint64_t)seconds * 1000000000ULL;
+}
+
+uint64_t
+Deadline::elapsed() const
+{
+    return monotonicNs() - m_start;
+}
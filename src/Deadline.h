@@ -0,0 +1,62 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include <stdint.h>
+
+//how much of the image a time-budgeted analysis got to
+struct scan_coverage
+{
+    unsigned logsFound;
+    unsigned logsParsed;
+    unsigned logsSkipped;
+    uint64_t bytesParsed;
+    uint64_t bytesSkipped;
+    //false if the walk for logs was cut short
+    bool walkComplete;
+    uint64_t filesScanned;
+    //false if the file scan was cut short or never started
+    bool filesComplete;
+
+    scan_coverage();
+    void add(const scan_coverage &other);
+};
+
+/*
+ * A time budget started once per analysis and read by every processor
+ * and thread taking part in it. Times are monotonic nanoseconds.
+ */
+class Deadline
+{
+    private:
+        uint64_t m_start;
+        uint64_t m_budget;
+    public:
+        Deadline() : m_start(0), m_budget(0) {}
+        void start(unsigned seconds);
+        bool isSet() const { return m_budget > 0; }
+        uint64_t elapsed() const;
+        bool expired() const { return isSet() && elapsed() >= m_budget; }
+        bool allows(uint64_t cost) const
+            { return !isSet() || elapsed() + cost < m_budget; }
+};
+
+uint64_t monotonicNs();
+
+#endif
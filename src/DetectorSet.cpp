@@ -0,0 +1,132 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DetectorSet.h"
+#include <string>
+#include "Detectors.h"
+#include "Stats.h"
+
+struct detector_name
+{
+    const char *name;
+    unsigned flag;
+};
+
+static const detector_name detectorNames[] = {
+    { "jumps", DETECT_JUMPS },
+    { "gaps", DETECT_GAPS },
+    { "divergence", DETECT_DIVERGENCE },
+    { "rate", DETECT_RATE },
+    { "clock", DETECT_CLOCK_EVENTS }
+};
+
+void
+DetectorSet::clear()
+{
+    for (size_t i = 0; i < m_detectors.size(); i++)
+        delete m_detectors[i];
+    m_detectors.clear();
+    m_kinds.clear();
+    m_found.clear();
+}
+
+void
+DetectorSet::configure(unsigned flags)
+{
+    if (flags == m_flags && !m_detectors.empty())
+        return;
+
+    clear();
+    m_flags = flags;
+    if (flags & DETECT_JUMPS)
+        add(new JumpDetector(m_jumps), DETECT_JUMPS);
+    if (flags & DETECT_GAPS)
+        add(new RecordGapDetector(), DETECT_GAPS);
+    if (flags & DETECT_DIVERGENCE)
+        add(new DivergenceDetector(), DETECT_DIVERGENCE);
+    if (flags & DETECT_RATE)
+        add(new RateDetector(), DETECT_RATE);
+    if (flags & DETECT_CLOCK_EVENTS)
+        add(new ClockEventDetector(), DETECT_CLOCK_EVENTS);
+    if ((flags & DETECT_SWEEP) && !m_sweep.empty())
+        add(new SweepDetector(m_sweep), DETECT_SWEEP);
+}
+
+void
+DetectorSet::add(IDetector *detector, unsigned kind)
+{
+    m_detectors.push_back(detector);
+    m_kinds.push_back(kind);
+    m_found.push_back(std::vector<log_finding>());
+}
+
+void
+DetectorSet::run(const std::vector<LogEvent*> &events)
+{
+    ScopedPhase phase(PHASE_DETECT);
+    size_t count = m_detectors.size();
+    for (size_t d = 0; d < count; d++)
+    {
+        m_detectors[d]->reset();
+        m_found[d].clear();
+    }
+
+    LogEvent *previous = NULL;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        LogEvent *event = events[i];
+        if (event->startsSegment())
+            previous = NULL;
+        for (size_t d = 0; d < count; d++)
+            m_detectors[d]->step(previous, event, m_found[d]);
+        previous = event;
+    }
+
+    if (previous != NULL)
+        for (size_t d = 0; d < count; d++)
+            m_detectors[d]->finish(previous, m_found[d]);
+}
+
+/*
+ * Turn a comma separated list of detector names into detector_flag_t
+ * bits. Returns 0 if a name is unknown.
+ */
+unsigned
+parseDetectorNames(const char *names)
+{
+    unsigned flags = 0;
+    std::string list(names);
+    size_t start = 0;
+    while (start <= list.length())
+    {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+            end = list.length();
+        std::string name = list.substr(start, end - start);
+
+        unsigned flag = 0;
+        for (size_t i = 0;
+                i < sizeof(detectorNames) / sizeof(detectorNames[0]); i++)
+            if (name == detectorNames[i].name)
+                flag = detectorNames[i].flag;
+        if (flag == 0)
+            return 0;
+        flags |= flag;
+        start = end + 1;
+    }
+    return flags;
+}
@@ -0,0 +1,72 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DETECTOR_SET_H
+#define DETECTOR_SET_H
+
+#include <vector>
+#include "IDetector.h"
+
+enum detector_flag_t {
+    DETECT_JUMPS        = 1 << 0,
+    DETECT_GAPS         = 1 << 1,
+    DETECT_DIVERGENCE   = 1 << 2,
+    DETECT_RATE         = 1 << 3,
+    DETECT_CLOCK_EVENTS = 1 << 4,
+    DETECT_SWEEP        = 1 << 5
+};
+
+/*
+ * The detectors that run over each log, chosen by detector_flag_t bits.
+ * run() makes a single pass over the events and hands every event to
+ * each detector before moving on, so the event is read once while the
+ * detectors' few words of state stay in cache. Each detector's findings
+ * are kept apart until the next run. The jump and sweep detectors take
+ * their thresholds from setJumpThresholds() and setSweep().
+ */
+class DetectorSet
+{
+    private:
+        unsigned m_flags;
+        jump_thresholds m_jumps;
+        std::vector<jump_thresholds> m_sweep;
+        std::vector<IDetector*> m_detectors;
+        std::vector<unsigned> m_kinds;
+        std::vector<std::vector<log_finding> > m_found;
+
+        void clear();
+    public:
+        DetectorSet() : m_flags(0) {}
+        ~DetectorSet() { clear(); }
+        void setJumpThresholds(const jump_thresholds &jumps)
+            { m_jumps = jumps; clear(); }
+        void setSweep(const std::vector<jump_thresholds> &sweep)
+            { m_sweep = sweep; clear(); }
+        void configure(unsigned flags);
+        void add(IDetector *detector, unsigned kind = 0);
+        void run(const std::vector<LogEvent*> &events);
+        size_t size() { return m_detectors.size(); }
+        IDetector* getDetector(size_t index) { return m_detectors[index]; }
+        //the detector_flag_t bit the detector was added for, or 0
+        unsigned getKind(size_t index) { return m_kinds[index]; }
+        std::vector<log_finding>& getFound(size_t index)
+            { return m_found[index]; }
+};
+
+unsigned parseDetectorNames(const char *names);
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Detectors.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+
+//EVTX event codes are not decoded yet, so Vista's 4616 cannot be matched
+static const int clockChangeEvents[] = { 520 };
+
+void
+JumpDetector::step(LogEvent *previous, LogEvent *event,
+        std::vector<log_finding> &found)
+{
+    if (previous == NULL)
+        return;
+
+    if (event->getDateCreated() + m_thresholds.backward <
+            previous->getDateCreated() ||
+            event->getDateWritten() + m_thresholds.backward <
+            previous->getDateWritten())
+        found.push_back(log_finding(BACKWARD_JUMP_ANOMALY, previous, event));
+    else if (event->getDateCreated() - m_thresholds.forward >
+            previous->getDateCreated() ||
+            event->getDateWritten() - m_thresholds.forward >
+            previous->getDateWritten())
+        found.push_back(log_finding(FORWARD_JUMP_ANOMALY, previous, event));
+}
+
+void
+SweepDetector::step(LogEvent *previous, LogEvent *event,
+        std::vector<log_finding> &found)
+{
+    if (previous == NULL)
+        return;
+
+    int64_t created = (int64_t)event->getDateCreated() -
+        previous->getDateCreated();
+    int64_t written = (int64_t)event->getDateWritten() -
+        previous->getDateWritten();
+    int64_t backward = -std::min(created, written);
+    int64_t forward = std::max(created, written);
+
+    for (size_t i = 0; i < m_thresholds.size(); i++)
+    {
+        if (backward > m_thresholds[i].backward)
+            found.push_back(log_finding(BACKWARD_JUMP_ANOMALY,
+                        previous, event, i));
+        else if (forward > m_thresholds[i].forward)
+            found.push_back(log_finding(FORWARD_JUMP_ANOMALY,
+                        previous, event, i));
+    }
+}
+
+void
+RecordGapDetector::step(LogEvent *previous, LogEvent *event,
+        std::vector<log_finding> &found)
+{
+    if (previous == NULL)
+        return;
+
+    uint32_t before = (uint32_t)previous->getEventId();
+    uint32_t after = (uint32_t)event->getEventId();
+    if (after > before && after - before > 1)
+        found.push_back(log_finding(RECORD_GAP_ANOMALY, previous, event,
+                    after - before - 1));
+}
+
+void
+DivergenceDetector::step(LogEvent *previous, LogEvent *event,
+        std::vector<log_finding> &found)
+{
+    int divergence = event->getDateWritten() - event->getDateCreated();
+    bool diverged = abs(divergence) > DIVERGENCE_DELTA;
+    if (diverged && !m_diverged)
+        found.push_back(log_finding(TIME_DIVERGENCE_ANOMALY,
+                    previous ? previous : event, event, divergence));
+    m_diverged = diverged;
+}
+
+void
+RateDetector::reset()
+{
+    m_first = NULL;
+    m_last = NULL;
+    m_start = 0;
+    m_count = 0;
+    m_buckets = 0;
+    m_average = 0;
+}
+
+//judge the hour that just ended against the ones before it
+void
+RateDetector::close(std::vector<log_finding> &found)
+{
+    if (m_buckets >= RATE_MIN_BUCKETS &&
+            ((m_count >= RATE_MIN_EVENTS &&
+              m_count > m_average * RATE_FACTOR) ||
+             (m_average >= RATE_MIN_EVENTS &&
+              m_count * RATE_FACTOR < m_average)))
+        found.push_back(log_finding(RATE_CHANGE_ANOMALY, m_first, m_last,
+                    m_count));
+
+    if (m_buckets == 0)
+        m_average = m_count;
+    else
+        m_average += (m_count - m_average) / 8;
+    m_buckets++;
+}
+
+void
+RateDetector::step(LogEvent *previous, LogEvent *event,
+        std::vector<log_finding> &found)
+{
+    int created = event->getDateCreated();
+    if (m_first != NULL &&
+            (created < m_start || created >= m_start + RATE_BUCKET))
+    {
+        close(found);
+        m_first = NULL;
+    }
+
+    if (m_first == NULL)
+    {
+        m_first = event;
+        m_start = created;
+        m_count = 0;
+    }
+    m_last = event;
+    m_count++;
+}
+
+void
+RateDetector::finish(LogEvent *last, std::vector<log_finding> &found)
+{
+    if (m_first != NULL)
+        close(found);
+}
+
+void
+ClockEventDetector::step(LogEvent *previous, LogEvent *event,
+        std::vector<log_finding> &found)
+{
+    int code = event->getEventCode();
+    for (size_t i = 0;
+            i < sizeof(clockChangeEvents) / sizeof(clockChangeEvents[0]);
+            i++)
+    {
+        if (code == clockChangeEvents[i])
+        {
+            found.push_back(log_finding(CLOCK_EVENT_ANOMALY,
+                        previous ? previous : event, event, code));
+            return;
+        }
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DETECTORS_H
+#define DETECTORS_H
+
+#include "IDetector.h"
+
+#define DIVERGENCE_DELTA    300
+#define RATE_BUCKET         3600
+#define RATE_FACTOR         8
+#define RATE_MIN_EVENTS     32
+#define RATE_MIN_BUCKETS    3
+
+/*
+ * Jumps of the clock between neighbouring events, more than the forward
+ * or backward threshold. These are what anomaly pairs are made of.
+ */
+class JumpDetector : public IDetector
+{
+    private:
+        jump_thresholds m_thresholds;
+    public:
+        JumpDetector(const jump_thresholds &thresholds =
+                jump_thresholds()) : m_thresholds(thresholds) {}
+        virtual const char* getName() { return "jumps"; }
+        virtual void step(LogEvent *previous, LogEvent *event,
+                std::vector<log_finding> &found);
+};
+
+/*
+ * The jump detector for several threshold pairs at once. Each step is
+ * measured once and compared against every pair; a finding's value is
+ * the index of the pair it was found under.
+ */
+class SweepDetector : public IDetector
+{
+    private:
+        std::vector<jump_thresholds> m_thresholds;
+    public:
+        SweepDetector(const std::vector<jump_thresholds> &thresholds) :
+            m_thresholds(thresholds) {}
+        virtual const char* getName() { return "sweep"; }
+        virtual void step(LogEvent *previous, LogEvent *event,
+                std::vector<log_finding> &found);
+};
+
+/*
+ * Record numbers skipped between neighbouring events, which is where
+ * records were deleted. Only meaningful on events in record order.
+ */
+class RecordGapDetector : public IDetector
+{
+    public:
+        virtual const char* getName() { return "gaps"; }
+        virtual void step(LogEvent *previous, LogEvent *event,
+                std::vector<log_finding> &found);
+};
+
+/*
+ * Events whose written time strays from their created time by more than
+ * DIVERGENCE_DELTA, reported where a run of them begins. A clock change
+ * between an event being raised and written shows up this way.
+ */
+class DivergenceDetector : public IDetector
+{
+    private:
+        bool m_diverged;
+    public:
+        DivergenceDetector() : m_diverged(false) {}
+        virtual const char* getName() { return "divergence"; }
+        virtual void reset() { m_diverged = false; }
+        virtual void step(LogEvent *previous, LogEvent *event,
+                std::vector<log_finding> &found);
+};
+
+/*
+ * Hours of the log, by created time, with RATE_FACTOR times more or fewer
+ * events than the running average of the hours before them.
+ */
+class RateDetector : public IDetector
+{
+    private:
+        LogEvent *m_first;
+        LogEvent *m_last;
+        int m_start;
+        int m_count;
+        int m_buckets;
+        double m_average;
+
+        void close(std::vector<log_finding> &found);
+    public:
+        RateDetector() { reset(); }
+        virtual const char* getName() { return "rate"; }
+        virtual void reset();
+        virtual void step(LogEvent *previous, LogEvent *event,
+                std::vector<log_finding> &found);
+        virtual void finish(LogEvent *last,
+                std::vector<log_finding> &found);
+};
+
+/*
+ * Events Windows writes when the system time is changed: 520 in the
+ * Security log before Vista. Only EVT records carry their event code.
+ */
+class ClockEventDetector : public IDetector
+{
+    public:
+        virtual const char* getName() { return "clock"; }
+        virtual void step(LogEvent *previous, LogEvent *event,
+                std::vector<log_finding> &found);
+};
+
+#endif
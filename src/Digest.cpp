@@ -0,0 +1,391 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Digest.h"
+#include <string.h>
+#include <string>
+
+struct hash_name
+{
+    const char *name;
+    unsigned flag;
+};
+
+static const hash_name hashNames[] = {
+    { "md5", HASH_MD5 },
+    { "sha1", HASH_SHA1 },
+    { "sha256", HASH_SHA256 }
+};
+
+static inline uint32_t rol(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+static inline uint32_t ror(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+static inline uint32_t loadLe32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t loadBe32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline void storeBe32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+void
+BlockHash::update(const void *data, size_t length)
+{
+    const uint8_t *p = (const uint8_t*)data;
+    size_t used = m_length % 64;
+    m_length += length;
+
+    if (used > 0)
+    {
+        size_t take = 64 - used < length ? 64 - used : length;
+        memcpy(m_block + used, p, take);
+        p += take;
+        length -= take;
+        if (used + take < 64)
+            return;
+        transform(m_block);
+    }
+    for (; length >= 64; p += 64, length -= 64)
+        transform(p);
+    memcpy(m_block, p, length);
+}
+
+void
+BlockHash::pad(bool bigEndian)
+{
+    size_t used = m_length % 64;
+    m_block[used++] = 0x80;
+    if (used > 56)
+    {
+        memset(m_block + used, 0, 64 - used);
+        transform(m_block);
+        used = 0;
+    }
+    memset(m_block + used, 0, 56 - used);
+
+    uint64_t bits = m_length * 8;
+    for (int i = 0; i < 8; i++)
+        m_block[bigEndian ? 63 - i : 56 + i] = bits >> (8 * i);
+    transform(m_block);
+}
+
+//MD5 (RFC 1321)
+
+static const uint32_t kMd5Sines[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+    0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+    0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+    0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+    0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+    0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const int kMd5Shifts[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+Md5::Md5()
+{
+    m_state[0] = 0x67452301;
+    m_state[1] = 0xefcdab89;
+    m_state[2] = 0x98badcfe;
+    m_state[3] = 0x10325476;
+}
+
+void
+Md5::transform(const uint8_t *block)
+{
+    uint32_t w[16];
+    for (int i = 0; i < 16; i++)
+        w[i] = loadLe32(block + 4 * i);
+
+    uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t f;
+        int g;
+        if (i < 16)
+        {
+            f = (b & c) | (~b & d);
+            g = i;
+        }
+        else if (i < 32)
+        {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) % 16;
+        }
+        else if (i < 48)
+        {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) % 16;
+        }
+        else
+        {
+            f = c ^ (b | ~d);
+            g = (7 * i) % 16;
+        }
+        uint32_t t = d;
+        d = c;
+        c = b;
+        b = b + rol(a + f + kMd5Sines[i] + w[g], kMd5Shifts[i]);
+        a = t;
+    }
+    m_state[0] += a;
+    m_state[1] += b;
+    m_state[2] += c;
+    m_state[3] += d;
+}
+
+void
+Md5::final(uint8_t digest[MD5_SIZE])
+{
+    pad(false);
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            digest[4 * i + j] = m_state[i] >> (8 * j);
+}
+
+//SHA-1 (FIPS 180-4)
+
+Sha1::Sha1()
+{
+    m_state[0] = 0x67452301;
+    m_state[1] = 0xefcdab89;
+    m_state[2] = 0x98badcfe;
+    m_state[3] = 0x10325476;
+    m_state[4] = 0xc3d2e1f0;
+}
+
+void
+Sha1::transform(const uint8_t *block)
+{
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++)
+        w[i] = loadBe32(block + 4 * i);
+    for (int i = 16; i < 80; i++)
+        w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+    uint32_t e = m_state[4];
+    for (int i = 0; i < 80; i++)
+    {
+        uint32_t f, k;
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        uint32_t t = rol(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rol(b, 30);
+        b = a;
+        a = t;
+    }
+    m_state[0] += a;
+    m_state[1] += b;
+    m_state[2] += c;
+    m_state[3] += d;
+    m_state[4] += e;
+}
+
+void
+Sha1::final(uint8_t digest[SHA1_SIZE])
+{
+    pad(true);
+    for (int i = 0; i < 5; i++)
+        storeBe32(digest + 4 * i, m_state[i]);
+}
+
+//SHA-256 (FIPS 180-4)
+
+static const uint32_t kSha256Rounds[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+Sha256::Sha256()
+{
+    m_state[0] = 0x6a09e667;
+    m_state[1] = 0xbb67ae85;
+    m_state[2] = 0x3c6ef372;
+    m_state[3] = 0xa54ff53a;
+    m_state[4] = 0x510e527f;
+    m_state[5] = 0x9b05688c;
+    m_state[6] = 0x1f83d9ab;
+    m_state[7] = 0x5be0cd19;
+}
+
+void
+Sha256::transform(const uint8_t *block)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+        w[i] = loadBe32(block + 4 * i);
+    for (int i = 16; i < 64; i++)
+    {
+        uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^
+            (w[i - 15] >> 3);
+        uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^
+            (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t s[8];
+    memcpy(s, m_state, sizeof(s));
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t e = s[4];
+        uint32_t a = s[0];
+        uint32_t t1 = s[7] + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) +
+            ((e & s[5]) ^ (~e & s[6])) + kSha256Rounds[i] + w[i];
+        uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) +
+            ((a & s[1]) ^ (a & s[2]) ^ (s[1] & s[2]));
+        memmove(s + 1, s, 7 * sizeof(uint32_t));
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+    for (int i = 0; i < 8; i++)
+        m_state[i] += s[i];
+}
+
+void
+Sha256::final(uint8_t digest[SHA256_SIZE])
+{
+    pad(true);
+    for (int i = 0; i < 8; i++)
+        storeBe32(digest + 4 * i, m_state[i]);
+}
+
+std::string
+hexDigest(const uint8_t *digest, size_t length)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(2 * length, '0');
+    for (size_t i = 0; i < length; i++)
+    {
+        hex[2 * i] = digits[digest[i] >> 4];
+        hex[2 * i + 1] = digits[digest[i] & 0xf];
+    }
+    return hex;
+}
+
+/*
+ * Turn a comma separated list of hash names into hash_flag_t bits.
+ * Returns 0 if a name is unknown.
+ */
+unsigned
+parseHashNames(const char *names)
+{
+    unsigned flags = 0;
+    std::string list(names);
+    size_t start = 0;
+    while (start <= list.length())
+    {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+            end = list.length();
+        std::string name = list.substr(start, end - start);
+
+        unsigned flag = 0;
+        for (size_t i = 0; i < sizeof(hashNames) / sizeof(hashNames[0]); i++)
+            if (name == hashNames[i].name)
+                flag = hashNames[i].flag;
+        if (flag == 0)
+            return 0;
+        flags |= flag;
+        start = end + 1;
+    }
+    return flags;
+}
+
+std::vector<std::pair<const char*, std::string> >
+listDigests(const file_digests *digests)
+{
+    std::vector<std::pair<const char*, std::string> > list;
+    if (digests == NULL)
+        return list;
+    if (digests->kinds & HASH_MD5)
+        list.push_back(std::make_pair("md5",
+                    hexDigest(digests->md5, MD5_SIZE)));
+    if (digests->kinds & HASH_SHA1)
+        list.push_back(std::make_pair("sha1",
+                    hexDigest(digests->sha1, SHA1_SIZE)));
+    if (digests->kinds & HASH_SHA256)
+        list.push_back(std::make_pair("sha256",
+                    hexDigest(digests->sha256, SHA256_SIZE)));
+    return list;
+}
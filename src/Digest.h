@@ -0,0 +1,106 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum hash_flag_t {
+    HASH_MD5    = 0x01,
+    HASH_SHA1   = 0x02,
+    HASH_SHA256 = 0x04
+};
+
+#define MD5_SIZE        16
+#define SHA1_SIZE       20
+#define SHA256_SIZE     32
+
+/*
+ * The block hashes logs and matched files are identified by, fed in
+ * pieces with update() and read once with final(). They share their
+ * Merkle-Damgard framing: 64 byte blocks, then a 0x80 byte, zeros and
+ * the bit length.
+ */
+class BlockHash
+{
+    private:
+        uint64_t m_length;
+        uint8_t m_block[64];
+    protected:
+        BlockHash() : m_length(0) {}
+        virtual ~BlockHash() {}
+        virtual void transform(const uint8_t *block) = 0;
+        //the length goes in little-endian for MD5, big-endian otherwise
+        void pad(bool bigEndian);
+    public:
+        void update(const void *data, size_t length);
+};
+
+class Md5 : public BlockHash
+{
+    private:
+        uint32_t m_state[4];
+    protected:
+        void transform(const uint8_t *block);
+    public:
+        Md5();
+        void final(uint8_t digest[MD5_SIZE]);
+};
+
+class Sha1 : public BlockHash
+{
+    private:
+        uint32_t m_state[5];
+    protected:
+        void transform(const uint8_t *block);
+    public:
+        Sha1();
+        void final(uint8_t digest[SHA1_SIZE]);
+};
+
+class Sha256 : public BlockHash
+{
+    private:
+        uint32_t m_state[8];
+    protected:
+        void transform(const uint8_t *block);
+    public:
+        Sha256();
+        void final(uint8_t digest[SHA256_SIZE]);
+};
+
+//the hashes of one file's content, those in kinds (hash_flag_t) set
+struct file_digests
+{
+    unsigned kinds;
+    uint8_t md5[MD5_SIZE];
+    uint8_t sha1[SHA1_SIZE];
+    uint8_t sha256[SHA256_SIZE];
+};
+
+std::string hexDigest(const uint8_t *digest, size_t length);
+unsigned parseHashNames(const char *names);
+//the hashes set, as name and hex string, in the order they are listed
+std::vector<std::pair<const char*, std::string> > listDigests(
+        const file_digests *digests);
+
+#endif
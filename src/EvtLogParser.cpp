@@ -21,10 +21,15 @@
 #include <string.h>
 #include <time.h>
 #include "exceptions/Exception.h"
+#include "BlockCache.h"
+#include "Stats.h"
+#include "TimeWindow.h"
+#include "Trace.h"
 
 #define HEADER_SIZE     0x30
 #define CURSOR_SIZE     0x28
 #define LOG_FIXED_SIZE  0x38
+#define SAMPLE_SCAN     0x1000
 
 #define HEADER_MAGIC    "\x4C\x66\x4C\x65"
 #define HEADER_VERSION  "\x01\x00\x00\x00\x01\x00\x00\x00"
@@ -149,21 +154,19 @@ void printCursor(EvtCursor_t cursor)
 }
 
 RecordType
-getRecordType(TSK_FS_FILE *file, int offset)
+getRecordType(BlockCache *file, int offset)
 {
     RecordType retval = EVT_RECORD_UNKOWN;
 
     int32_t size;
-    int read = tsk_fs_file_read(file, offset, (char*)&size, sizeof(size),
-            TSK_FS_FILE_READ_FLAG_NONE);
+    int read = file->read(offset, (char*)&size, sizeof(size));
     if (read == 4)
     {
         if (size == HEADER_SIZE)
         {
             //read and verify magic
             char hmagic[12];
-            tsk_fs_file_read(file, offset + 4, hmagic, 12,
-                    TSK_FS_FILE_READ_FLAG_NONE);
+            file->read(offset + 4, hmagic, 12);
             if (strncmp(hmagic, HEADER_MAGIC HEADER_VERSION, 12) == 0)
                 retval = EVT_RECORD_HEADER;
         }
@@ -171,8 +174,7 @@ getRecordType(TSK_FS_FILE *file, int offset)
         {
             //read and verify magic
             char cmagic[16];
-            tsk_fs_file_read(file, offset + 4, cmagic, 16,
-                    TSK_FS_FILE_READ_FLAG_NONE);
+            file->read(offset + 4, cmagic, 16);
             if (strncmp(cmagic, CURSOR_MAGIC, 16) == 0)
                 retval = EVT_RECORD_CURSOR;
         }
@@ -180,11 +182,10 @@ getRecordType(TSK_FS_FILE *file, int offset)
         {
             //read and verify magic and weather or not wrapped
             char lmagic[4];
-            tsk_fs_file_read(file, offset + 4, lmagic, 4,
-                    TSK_FS_FILE_READ_FLAG_NONE);
+            file->read(offset + 4, lmagic, 4);
             if (strncmp(lmagic, HEADER_MAGIC, 4) == 0)
             {
-                if (offset + size >= file->meta->size)
+                if (offset + size >= file->getSize())
                     retval = EVT_RECORD_WRAPPED;
                 else
                     retval = EVT_RECORD_LOG;
@@ -196,12 +197,12 @@ getRecordType(TSK_FS_FILE *file, int offset)
 }
 
 int
-findLastIndexOfCursor(TSK_FS_FILE *file)
+findLastIndexOfCursor(BlockCache *file)
 {
     char cmagic[16];
-    for (int i = (file->meta->size - 16); i >= 0; i--)
+    for (int i = (file->getSize() - 16); i >= 0; i--)
     {
-        tsk_fs_file_read(file, i, cmagic, 16, TSK_FS_FILE_READ_FLAG_NONE);
+        file->read(i, cmagic, 16);
         if (strncmp(cmagic, CURSOR_MAGIC, 16) == 0)
             return i - 4;
     }
@@ -210,40 +211,35 @@ findLastIndexOfCursor(TSK_FS_FILE *file)
 }
 
 EvtLogRecord_t*
-getLogRecord(TSK_FS_FILE *file, int offset, int *newoffset)
+getLogRecord(BlockCache *file, int offset, int *newoffset)
 {
     EvtLogRecord_t *log = new EvtLogRecord_t;
     RecordType type = getRecordType(file, offset);
     if (type == EVT_RECORD_LOG)
     {
-        tsk_fs_file_read(file, offset, (char*)log, LOG_FIXED_SIZE,
-                TSK_FS_FILE_READ_FLAG_NONE);
+        file->read(offset, (char*)log, LOG_FIXED_SIZE);
         *newoffset = offset + log->record_length;
     }
     else if (type == EVT_RECORD_WRAPPED)
     {
         //read wrapped record
         int32_t rec_size;
-        tsk_fs_file_read(file, offset, (char*)&rec_size, sizeof(int32_t), 
-                TSK_FS_FILE_READ_FLAG_NONE);
-        int size = tsk_fs_file_read(file, offset, (char*)log, LOG_FIXED_SIZE,
-                TSK_FS_FILE_READ_FLAG_NONE);
+        file->read(offset, (char*)&rec_size, sizeof(int32_t));
+        int size = file->read(offset, (char*)log, LOG_FIXED_SIZE);
         if (size < LOG_FIXED_SIZE)
         {
             offset = HEADER_SIZE;
-            tsk_fs_file_read(file, offset, (char*)log, LOG_FIXED_SIZE,
-                    TSK_FS_FILE_READ_FLAG_NONE);
+            file->read(offset, (char*)log, LOG_FIXED_SIZE);
             *newoffset = offset + log->record_length;
         }
         else if (size == LOG_FIXED_SIZE)
         {
             *newoffset = HEADER_SIZE + 
-                (rec_size - ((file->meta->size) - offset));
+                (rec_size - ((file->getSize()) - offset));
         }
         else if (size < rec_size)
         {
-            tsk_fs_file_read(file, HEADER_SIZE, (char*)(log+size), 
-                    LOG_FIXED_SIZE - size, TSK_FS_FILE_READ_FLAG_NONE);
+            file->read(HEADER_SIZE, (char*)(log+size), LOG_FIXED_SIZE - size);
             *newoffset = HEADER_SIZE + (rec_size - size);
         }
         else
@@ -262,13 +258,20 @@ getLogRecord(TSK_FS_FILE *file, int offset, int *newoffset)
     return log;
 }
 
-std::vector<LogEvent*>
-EvtLogParser::parseLogFile(TSK_FS_FILE *file, const char *path)
+static LogEvent*
+newEvent(EvtLogRecord_t *rec)
 {
-    if (tsk_verbose)
-        std::cerr << "\nattempting to parse (" << file->name->name << ")\n";
-    std::vector<LogEvent*> events;
+    return new LogEvent(rec->message_number, rec->date_created,
+            rec->date_written, rec->event_id & 0xffff);
+}
 
+/*
+ * Read the header and the cursor, which between them bound the records
+ * in the ring.
+ */
+static void
+readBounds(BlockCache *file, EvtHeader_t &header, EvtCursor_t &cursor)
+{
     // Make sure header exists
     RecordType type = getRecordType(file, 0);
     if (type != EVT_RECORD_HEADER)
@@ -276,9 +279,7 @@ EvtLogParser::parseLogFile(TSK_FS_FILE *file, const char *path)
         throw ReadException("could not find header record");
     }
 
-    EvtHeader_t header;
-    int size = tsk_fs_file_read(file, 0, (char*)&header, sizeof(header), 
-            TSK_FS_FILE_READ_FLAG_NONE);
+    int size = file->read(0, (char*)&header, sizeof(header));
 
     if (size != HEADER_SIZE)
     {
@@ -292,7 +293,6 @@ EvtLogParser::parseLogFile(TSK_FS_FILE *file, const char *path)
     }
 
     // Get cursor
-    EvtCursor_t cursor;
     type = getRecordType(file, header.write_offset);
     if (type != EVT_RECORD_CURSOR)
     {
@@ -307,8 +307,8 @@ EvtLogParser::parseLogFile(TSK_FS_FILE *file, const char *path)
         if(offset >= 0 && 
                 ((type = getRecordType(file, offset)) == EVT_RECORD_CURSOR))
         {
-            size = tsk_fs_file_read(file, header.write_offset, (char*)&cursor,
-                    sizeof(cursor), TSK_FS_FILE_READ_FLAG_NONE);
+            size = file->read(header.write_offset, (char*)&cursor,
+                    sizeof(cursor));
         }
         else
         {
@@ -318,8 +318,7 @@ EvtLogParser::parseLogFile(TSK_FS_FILE *file, const char *path)
     else
     {
         // Found cursor. Read it in.
-        size = tsk_fs_file_read(file, header.write_offset, (char*)&cursor,
-                sizeof(cursor), TSK_FS_FILE_READ_FLAG_NONE);
+        size = file->read(header.write_offset, (char*)&cursor, sizeof(cursor));
     }
 
     if (size != CURSOR_SIZE)
@@ -329,17 +328,51 @@ EvtLogParser::parseLogFile(TSK_FS_FILE *file, const char *path)
 
     if (tsk_verbose)
         printCursor(cursor);
+}
+
+/*
+ * The first whole record starting within SAMPLE_SCAN bytes of offset, so
+ * a sample can land anywhere in the ring. Returns -1 if there is none.
+ */
+static int
+findRecord(BlockCache *file, int offset)
+{
+    char buf[SAMPLE_SCAN];
+    int length = file->read(offset, buf, SAMPLE_SCAN);
+    for (int i = 4; i + 4 <= length; i++)
+    {
+        if (memcmp(buf + i, HEADER_MAGIC, 4) == 0 &&
+                getRecordType(file, offset + i - 4) == EVT_RECORD_LOG)
+            return offset + i - 4;
+    }
 
+    return -1;
+}
+
+std::vector<LogEvent*>
+EvtLogParser::parseLogFile(BlockCache *file, const char *path)
+{
+    TRACE_SCOPE_FILE("EvtLogParser::parseLogFile", path, file->getName());
+    ScopedPhase phase(PHASE_DECODE);
+    if (tsk_verbose)
+        std::cerr << "\nattempting to parse (" << file->getName() << ")\n";
+    std::vector<LogEvent*> events;
+
+    EvtHeader_t header;
+    EvtCursor_t cursor;
+    readBounds(file, header, cursor);
+
+    //the whole ring is walked even with a window: a clock set past it
+    //and then back puts in-window records after out-of-window ones
+    TimeWindow window(m_since, m_until);
     int offset = header.first_offset;
     for (int i = cursor.first_record_number; i < cursor.next_record_number; i++)
     {
         int newoff;
         EvtLogRecord_t *rec = getLogRecord(file, offset, &newoff);
         if (rec == NULL) break;
-        events.push_back(new LogEvent(
-                    rec->message_number, 
-                    rec->date_created, 
-                    rec->date_written));
+        window.add(events, newEvent(rec));
+        Stats::addRecords(1);
         offset = newoff;
         delete rec;
     }
@@ -347,8 +380,96 @@ EvtLogParser::parseLogFile(TSK_FS_FILE *file, const char *path)
     return events;
 }
 
+/*
+ * Spread the samples evenly over the ring from the oldest record to the
+ * cursor. Each lands on the next record boundary; a candidate must carry
+ * a record number the cursor vouches for, so stale records and string
+ * data that happen to contain the magic are passed over.
+ */
+std::vector<LogEvent*>
+EvtLogParser::sampleLogFile(BlockCache *file, const char *path,
+        size_t count, std::vector<TSK_OFF_T> &offsets)
+{
+    TRACE_SCOPE_FILE("EvtLogParser::sampleLogFile", path, file->getName());
+    ScopedPhase phase(PHASE_DECODE);
+    std::vector<LogEvent*> events;
+
+    EvtHeader_t header;
+    EvtCursor_t cursor;
+    readBounds(file, header, cursor);
+
+    TSK_OFF_T size = file->getSize();
+    TSK_OFF_T ring = header.write_offset - header.first_offset;
+    if (ring < 0)
+        ring += size - HEADER_SIZE;
+
+    int last = -1;
+    for (size_t s = 0; s < count; s++)
+    {
+        TSK_OFF_T position = header.first_offset + ring * s / count;
+        if (position >= size)
+            position -= size - HEADER_SIZE;
+        int offset = findRecord(file, position);
+        if (offset < 0 || offset == last)
+            continue;
+
+        EvtLogRecord_t rec;
+        if (file->read(offset, (char*)&rec, LOG_FIXED_SIZE) !=
+                LOG_FIXED_SIZE ||
+                (uint32_t)rec.message_number < cursor.first_record_number ||
+                (uint32_t)rec.message_number >= cursor.next_record_number)
+            continue;
+
+        events.push_back(newEvent(&rec));
+        offsets.push_back(offset);
+        Stats::addRecords(1);
+        last = offset;
+    }
+
+    return events;
+}
+
+std::vector<LogEvent*>
+EvtLogParser::parseRegion(BlockCache *file, const char *path,
+        TSK_OFF_T start, TSK_OFF_T end)
+{
+    TRACE_SCOPE_FILE("EvtLogParser::parseRegion", path, file->getName());
+    ScopedPhase phase(PHASE_DECODE);
+    std::vector<LogEvent*> events;
+
+    EvtHeader_t header;
+    EvtCursor_t cursor;
+    readBounds(file, header, cursor);
+
+    //the walk may wrap the ring, so it is bounded by the record count
+    TimeWindow window(m_since, m_until);
+    int offset = start;
+    uint32_t records = cursor.next_record_number - cursor.first_record_number;
+    for (uint32_t i = 0; i < records; i++)
+    {
+        int newoff;
+        EvtLogRecord_t *rec = getLogRecord(file, offset, &newoff);
+        if (rec == NULL) break;
+        window.add(events, newEvent(rec));
+        Stats::addRecords(1);
+        delete rec;
+        if (offset == end)
+            break;
+        offset = newoff;
+    }
+
+    return events;
+}
+
 std::string
 EvtLogParser::getExtension()
 {
     return std::string("evt");
 }
+
+bool
+EvtLogParser::matchesSignature(const char *header, size_t length)
+{
+    //the signature follows the 4 byte header length
+    return length >= 8 && memcmp(header + 4, HEADER_MAGIC, 4) == 0;
+}
@@ -22,6 +22,10 @@
 #include <time.h>
 #include "Crc32.h"
 #include "exceptions/Exception.h"
+#include "BlockCache.h"
+#include "Stats.h"
+#include "TimeWindow.h"
+#include "Trace.h"
 
 #define EPOCH_DIFF 0x019DB1DED53E8000LL /* 116444736000000000 nsecs */
 #define RATE_DIFF 10000000 /* 100 nsecs */
@@ -86,6 +90,8 @@ time_t fileTimeToUnixTime(int64_t ftime) {
 
 bool checkHeader(EvtxHeader_t *header)
 {
+    ScopedPhase phase(PHASE_CRC);
+
     if (strncmp(header->magic, HEADER_MAGIC, 8))
         return false;
 
@@ -137,6 +143,8 @@ void printChunkHeader(EvtxChunkHeader_t *chunk_head)
 
 bool checkChunkHeader(EvtxChunkHeader_t *chunk_head)
 {
+    ScopedPhase phase(PHASE_CRC);
+
     if (strncmp(chunk_head->magic, CHUNK_MAGIC, 8))
         return false;
 
@@ -149,6 +157,7 @@ bool checkChunkHeader(EvtxChunkHeader_t *chunk_head)
 
 bool checkChunkData(uint8_t *data, uint32_t length, uint32_t crc)
 {
+    ScopedPhase phase(PHASE_CRC);
     Crc32 crc32;
     crc32.addData(data, length);
 
@@ -160,17 +169,11 @@ bool checkEvent(EvtxEventRecord_t *event)
     return strncmp(event->magic, EVENT_MAGIC, 4) == 0;
 }
 
-std::vector<LogEvent*>
-EvtxLogParser::parseLogFile(TSK_FS_FILE *file, const char *path)
+static void
+readHeader(BlockCache *file, EvtxHeader_t *header)
 {
-    if (tsk_verbose)
-        std::cerr << "\nattempting to parse (" << file->name->name << ")\n";
-    std::vector<LogEvent*> events;
-
-    EvtxHeader_t header;
-    int size = tsk_fs_file_read(file, 0, (char*)&header, sizeof(header),
-            TSK_FS_FILE_READ_FLAG_NONE);
-    if (!checkHeader(&header))
+    int size = file->read(0, (char*)header, sizeof(*header));
+    if (!checkHeader(header))
     {
         throw ReadException("could not find header record");
     }
@@ -180,15 +183,71 @@ EvtxLogParser::parseLogFile(TSK_FS_FILE *file, const char *path)
     }
 
     if (tsk_verbose)
-        printHeader(&header);
+        printHeader(header);
+}
+
+//check and decode every event of the chunk at chunk_offset
+static void
+decodeChunk(BlockCache *file, int32_t chunk_offset,
+        EvtxChunkHeader_t *chunk_head, TimeWindow &window,
+        std::vector<LogEvent*> &events)
+{
+    int len = chunk_head->offset_next - 0x200;
+    char data[len];
+    file->read(chunk_offset + 0x200, data, len);
+
+    if (!checkChunkData((uint8_t*)data, len, chunk_head->data_check_sum))
+    {
+        throw ReadException("chunk data not valid");
+    }
+
+    //read events
+    int event_offset = 0x200;
+    EvtxEventRecord_t event;
+    while (event_offset < chunk_head->offset_next)
+    {
+        file->read(chunk_offset + event_offset,
+                (char*)&event, sizeof(event));
+
+        if (!checkEvent(&event))
+        {
+            throw Exception("event not valid");
+        }
+
+        time_t time = fileTimeToUnixTime(event.time_created);
+        window.add(events, new LogEvent(
+                    event.record_id,
+                    time,
+                    time));
+        Stats::addRecords(1);
+
+        //next offset
+        event_offset += event.length;
+    }
+}
+
+std::vector<LogEvent*>
+EvtxLogParser::parseLogFile(BlockCache *file, const char *path)
+{
+    TRACE_SCOPE_FILE("EvtxLogParser::parseLogFile", path, file->getName());
+    ScopedPhase phase(PHASE_DECODE);
+    if (tsk_verbose)
+        std::cerr << "\nattempting to parse (" << file->getName() << ")\n";
+    std::vector<LogEvent*> events;
+
+    EvtxHeader_t header;
+    readHeader(file, &header);
 
     //read chunks
+    //every chunk is decoded even with a window: a chunk's events need not
+    //be in time order, so its first and last say nothing about the middle
+    TimeWindow window(m_since, m_until);
     EvtxChunkHeader_t chunk_head;
     int32_t chunk_offset = header.header_len;
     for (int chunk = 0; chunk < header.chunk_count; chunk++)
     {
-        size = tsk_fs_file_read(file, chunk_offset, (char*)&chunk_head,
-                sizeof(chunk_head), TSK_FS_FILE_READ_FLAG_NONE);
+        TRACE_SCOPE_INDEX("EvtxLogParser::chunk", chunk);
+        file->read(chunk_offset, (char*)&chunk_head, sizeof(chunk_head));
         if (!checkChunkHeader(&chunk_head))
         {
             throw ReadException("chunk header not valid");
@@ -197,40 +256,89 @@ EvtxLogParser::parseLogFile(TSK_FS_FILE *file, const char *path)
         if (tsk_verbose)
             printChunkHeader(&chunk_head);
 
-        int len = chunk_head.offset_next - 0x200;
-        char data[len];
-        size = tsk_fs_file_read(file, chunk_offset + 0x200, data,
-                len, TSK_FS_FILE_READ_FLAG_NONE);
+        decodeChunk(file, chunk_offset, &chunk_head, window, events);
+        chunk_offset += 0x10000;
+    }
+
+    return events;
+}
+
+/*
+ * Take the first and last events of chunks spread evenly over the file.
+ * Only the chunk headers are checked; chunks that fail are passed over.
+ */
+std::vector<LogEvent*>
+EvtxLogParser::sampleLogFile(BlockCache *file, const char *path,
+        size_t count, std::vector<TSK_OFF_T> &offsets)
+{
+    TRACE_SCOPE_FILE("EvtxLogParser::sampleLogFile", path, file->getName());
+    ScopedPhase phase(PHASE_DECODE);
+    std::vector<LogEvent*> events;
+
+    EvtxHeader_t header;
+    readHeader(file, &header);
 
-        if (!checkChunkData((uint8_t*)data, len, chunk_head.data_check_sum))
+    size_t chunks = count / 2 > 0 ? count / 2 : 1;
+    int last = -1;
+    for (size_t s = 0; s < chunks; s++)
+    {
+        int chunk = s * header.chunk_count / chunks;
+        if (chunk >= header.chunk_count || chunk == last)
+            continue;
+        last = chunk;
+
+        EvtxChunkHeader_t chunk_head;
+        int32_t chunk_offset = header.header_len + chunk * 0x10000;
+        file->read(chunk_offset, (char*)&chunk_head, sizeof(chunk_head));
+        if (!checkChunkHeader(&chunk_head) || chunk_head.offset_last < 0x200)
+            continue;
+
+        uint32_t ends[2] = {0x200, chunk_head.offset_last};
+        for (int e = 0; e < 2; e++)
         {
-            throw ReadException("chunk data not valid");
+            if (e == 1 && ends[1] == ends[0])
+                break;
+            EvtxEventRecord_t event;
+            if (file->read(chunk_offset + ends[e], (char*)&event,
+                        sizeof(event)) != sizeof(event) ||
+                    !checkEvent(&event))
+                continue;
+            time_t time = fileTimeToUnixTime(event.time_created);
+            events.push_back(new LogEvent(event.record_id, time, time));
+            offsets.push_back(chunk_offset + ends[e]);
+            Stats::addRecords(1);
         }
+    }
 
-        //read events
-        int event_offset = 0x200;
-        EvtxEventRecord_t event;
-        while (event_offset < chunk_head.offset_next)
-        {
-            size = tsk_fs_file_read(file, chunk_offset + event_offset, 
-                    (char*)&event, sizeof(event), TSK_FS_FILE_READ_FLAG_NONE);
+    return events;
+}
 
-            if (!checkEvent(&event))
-            {
-                throw Exception("event not valid");
-            }
+//whole chunks are decoded, from the one holding start to the one with end
+std::vector<LogEvent*>
+EvtxLogParser::parseRegion(BlockCache *file, const char *path,
+        TSK_OFF_T start, TSK_OFF_T end)
+{
+    TRACE_SCOPE_FILE("EvtxLogParser::parseRegion", path, file->getName());
+    ScopedPhase phase(PHASE_DECODE);
+    std::vector<LogEvent*> events;
 
-            time_t time = fileTimeToUnixTime(event.time_created);
-            events.push_back(new LogEvent(
-                        event.record_id,
-                        time,
-                        time));
+    EvtxHeader_t header;
+    readHeader(file, &header);
 
-            //next offset
-            event_offset += event.length;
+    TimeWindow window(m_since, m_until);
+    int first = (start - header.header_len) / 0x10000;
+    int last = (end - header.header_len) / 0x10000;
+    for (int chunk = first; chunk <= last && chunk < header.chunk_count;
+            chunk++)
+    {
+        EvtxChunkHeader_t chunk_head;
+        int32_t chunk_offset = header.header_len + chunk * 0x10000;
+        file->read(chunk_offset, (char*)&chunk_head, sizeof(chunk_head));
+        if (!checkChunkHeader(&chunk_head))
+        {
+            throw ReadException("chunk header not valid");
         }
-
-        chunk_offset += 0x10000;
+        decodeChunk(file, chunk_offset, &chunk_head, window, events);
     }
 
     return events;
@@ -241,3 +349,9 @@ EvtxLogParser::getExtension()
 {
     return std::string("evtx");
 }
+
+bool
+EvtxLogParser::matchesSignature(const char *header, size_t length)
+{
+    return length >= 8 && memcmp(header, HEADER_MAGIC, 8) == 0;
+}
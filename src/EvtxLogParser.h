@@ -24,8 +24,14 @@ class EvtxLogParser : public ILogParser
 {
     public:
         virtual std::vector<LogEvent*> 
-            parseLogFile(TSK_FS_FILE *file, const char *path);
+            parseLogFile(BlockCache *file, const char *path);
+        virtual std::vector<LogEvent*> sampleLogFile(BlockCache *file,
+                const char *path, size_t count,
+                std::vector<TSK_OFF_T> &offsets);
+        virtual std::vector<LogEvent*> parseRegion(BlockCache *file,
+                const char *path, TSK_OFF_T start, TSK_OFF_T end);
         virtual std::string getExtension();
+        virtual bool matchesSignature(const char *header, size_t length);
 };
 
 #endif
@@ -0,0 +1,430 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include "Exporter.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include "Stats.h"
+#include "Trace.h"
+
+//in the order the objects sit in, as near as inodes tell
+static bool jobOrder(const export_job &a, const export_job &b)
+{
+    if (a.fsOffset != b.fsOffset)
+        return a.fsOffset < b.fsOffset;
+    return a.inum < b.inum;
+}
+
+//a path component that cannot climb out of the export directory
+static std::string safeComponent(const std::string &component)
+{
+    if (component == "." || component == "..")
+        return "_";
+    std::string safe(component);
+    std::replace(safe.begin(), safe.end(), '/', '_');
+    return safe;
+}
+
+static void appendPath(std::string &target, const std::string &path)
+{
+    size_t start = 0;
+    while (start < path.length())
+    {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos)
+            end = path.length();
+        if (end > start)
+            target += "/" + safeComponent(path.substr(start, end - start));
+        start = end + 1;
+    }
+}
+
+/*
+ * Open the directory target goes in, creating what is missing below root
+ * one component at a time. Nothing under root is followed if it is a
+ * symlink, so a link planted in the tree cannot send writes elsewhere.
+ * Returns the directory and sets leaf to the name in it, or returns -1.
+ */
+static int openParent(const std::string &root, const std::string &target,
+        std::string &leaf)
+{
+    int dir = open(root.c_str(), O_RDONLY | O_DIRECTORY);
+    size_t start = root.length() + 1;
+    for (size_t slash = target.find('/', start);
+            dir >= 0 && slash != std::string::npos;
+            slash = target.find('/', start))
+    {
+        std::string component = target.substr(start, slash - start);
+        int next = -1;
+        if (mkdirat(dir, component.c_str(), 0755) == 0 || errno == EEXIST)
+            next = openat(dir, component.c_str(),
+                    O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+        close(dir);
+        dir = next;
+        start = slash + 1;
+    }
+    leaf = target.substr(start);
+    return dir;
+}
+
+//a new file, or one left by an earlier export, but never through a link
+static int createLeaf(int dir, const std::string &leaf)
+{
+    int out = openat(dir, leaf.c_str(),
+            O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, 0644);
+    if (out < 0 && errno == EEXIST)
+        out = openat(dir, leaf.c_str(), O_WRONLY | O_TRUNC | O_NOFOLLOW);
+    return out;
+}
+
+static bool writeAll(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+FileExporter::FileExporter(const std::string &root) :
+    m_root(root), m_next(0), m_count(0), m_images(NULL),
+    m_type(TSK_IMG_TYPE_DETECT), m_imageFd(-1), m_deadline(NULL),
+    m_exported(0), m_failed(0), m_zeroCopy(1)
+{
+    pthread_mutex_init(&m_lock, NULL);
+}
+
+FileExporter::~FileExporter()
+{
+    if (m_imageFd >= 0)
+        close(m_imageFd);
+    pthread_mutex_destroy(&m_lock);
+}
+
+void
+FileExporter::add(TSK_OFF_T fsOffset, TSK_INUM_T inum,
+        const std::string &volume, const std::string &path,
+        const std::string &name)
+{
+    export_job job;
+    job.fsOffset = fsOffset;
+    job.inum = inum;
+    job.target = m_root;
+    if (!volume.empty())
+        job.target += "/" + safeComponent(volume);
+    appendPath(job.target, path);
+    job.target += "/" + safeComponent(name);
+
+    pthread_mutex_lock(&m_lock);
+    if (m_targets.insert(job.target).second)
+        m_jobs.push_back(job);
+    pthread_mutex_unlock(&m_lock);
+}
+
+//plain data runs on a raw image can be copied from the image file itself
+bool
+FileExporter::canCopyRuns(TSK_FS_FILE *file)
+{
+    if (m_imageFd < 0)
+        return false;
+
+    const TSK_FS_ATTR *attr = tsk_fs_file_attr_get(file);
+    if (attr == NULL)
+    {
+        tsk_error_reset();
+        return false;
+    }
+    if (!(attr->flags & TSK_FS_ATTR_NONRES) ||
+            (attr->flags & (TSK_FS_ATTR_COMP | TSK_FS_ATTR_ENC)))
+        return false;
+    for (TSK_FS_ATTR_RUN *run = attr->nrd.run; run; run = run->next)
+        if (run->flags & TSK_FS_ATTR_RUN_FLAG_FILLER)
+            return false;
+    return true;
+}
+
+/*
+ * Copy length bytes at from in the image to to in out, inside the kernel
+ * while copy_file_range() is supported between the two, with pread() and
+ * pwrite() otherwise. The first worker refused turns it off for all.
+ */
+bool
+FileExporter::copyRange(TSK_OFF_T from, TSK_OFF_T to, TSK_OFF_T length,
+        int out, std::vector<char> &buf)
+{
+#ifdef HAVE_COPY_FILE_RANGE
+    while (length > 0 && __sync_fetch_and_add(&m_zeroCopy, 0))
+    {
+        loff_t in_off = from, out_off = to;
+        ssize_t copied = copy_file_range(m_imageFd, &in_off, out, &out_off,
+                length, 0);
+        if (copied < 0 && errno == EINTR)
+            continue;
+        if (copied < 0 && (errno == EXDEV || errno == ENOSYS ||
+                    errno == EINVAL || errno == EOPNOTSUPP))
+        {
+            __sync_bool_compare_and_swap(&m_zeroCopy, 1, 0);
+            break;
+        }
+        if (copied <= 0)
+            return false;
+        Stats::addRead(copied);
+        from += copied;
+        to += copied;
+        length -= copied;
+    }
+#endif
+
+    while (length > 0)
+    {
+        size_t chunk = std::min(length, (TSK_OFF_T)buf.size());
+        ssize_t got;
+        {
+            ScopedPhase phase(PHASE_LOG_IO);
+            got = pread(m_imageFd, &buf[0], chunk, from);
+        }
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return false;
+        Stats::addRead(got);
+
+        for (ssize_t done = 0; done < got; )
+        {
+            ssize_t put = pwrite(out, &buf[done], got - done, to + done);
+            if (put < 0 && errno == EINTR)
+                continue;
+            if (put <= 0)
+                return false;
+            done += put;
+        }
+        from += got;
+        to += got;
+        length -= got;
+    }
+    return true;
+}
+
+/*
+ * Copy the initialized part of each allocated run to its place in the
+ * file. Sparse runs and the tail past the initialized size are left as
+ * holes by sizing the file at the end, so they read back as zeros.
+ */
+bool
+FileExporter::copyRuns(TSK_FS_FILE *file, int out, std::vector<char> &buf)
+{
+    const TSK_FS_ATTR *attr = tsk_fs_file_attr_get(file);
+    TSK_FS_INFO *fs = file->fs_info;
+    TSK_OFF_T size = file->meta->size;
+    TSK_OFF_T initialized = std::min(size, attr->nrd.initsize);
+
+    for (TSK_FS_ATTR_RUN *run = attr->nrd.run; run; run = run->next)
+    {
+        if (run->flags & TSK_FS_ATTR_RUN_FLAG_SPARSE)
+            continue;
+
+        TSK_OFF_T to = (TSK_OFF_T)run->offset * fs->block_size;
+        if (to >= initialized)
+            continue;
+        TSK_OFF_T length = std::min((TSK_OFF_T)run->len * fs->block_size,
+                initialized - to);
+        TSK_OFF_T from = fs->offset + (TSK_OFF_T)run->addr * fs->block_size;
+        if (!copyRange(from, to, length, out, buf))
+            return false;
+    }
+    return ftruncate(out, size) == 0;
+}
+
+bool
+FileExporter::copyStream(TSK_FS_FILE *file, int out, std::vector<char> &buf)
+{
+    TSK_OFF_T size = file->meta->size;
+    for (TSK_OFF_T offset = 0; offset < size; )
+    {
+        ssize_t length = countedFileRead(file, offset, &buf[0], buf.size(),
+                TSK_FS_FILE_READ_FLAG_NONE);
+        if (length <= 0)
+        {
+            tsk_error_reset();
+            return false;
+        }
+        if (!writeAll(out, &buf[0], length))
+            return false;
+        offset += length;
+    }
+    return true;
+}
+
+/*
+ * Copy one object to its target, keeping its access and modification
+ * times. A partial copy is removed.
+ */
+bool
+FileExporter::exportFile(TSK_FS_INFO *fs, const export_job &job,
+        std::vector<char> &buf)
+{
+    TSK_FS_FILE *file = tsk_fs_file_open_meta(fs, NULL, job.inum);
+    if (file == NULL || file->meta == NULL)
+    {
+        tsk_error_reset();
+        if (file)
+            tsk_fs_file_close(file);
+        return false;
+    }
+
+    std::string leaf;
+    int dir = openParent(m_root, job.target, leaf);
+    int out = dir >= 0 ? createLeaf(dir, leaf) : -1;
+    if (out < 0)
+    {
+        if (tsk_verbose)
+            std::cerr << "Unable to create " << job.target << std::endl;
+        if (dir >= 0)
+            close(dir);
+        tsk_fs_file_close(file);
+        return false;
+    }
+
+    bool copied = canCopyRuns(file) ? copyRuns(file, out, buf) :
+        copyStream(file, out, buf);
+
+    struct timeval times[2];
+    times[0].tv_sec = file->meta->atime;
+    times[0].tv_usec = 0;
+    times[1].tv_sec = file->meta->mtime;
+    times[1].tv_usec = 0;
+    if (copied)
+        futimes(out, times);
+
+    tsk_fs_file_close(file);
+    if (close(out) != 0)
+        copied = false;
+    if (!copied)
+        unlinkat(dir, leaf.c_str(), 0);
+    close(dir);
+    return copied;
+}
+
+/*
+ * One worker: takes the next object until none are left, opening each
+ * file system it needs once.
+ */
+void*
+FileExporter::work(void *arg)
+{
+    FileExporter *self = (FileExporter*)arg;
+    TRACE_SCOPE("FileExporter::work");
+
+    TSK_IMG_INFO *img = tsk_img_open(self->m_count, self->m_images,
+            self->m_type, 0);
+    if (img == NULL)
+    {
+        tsk_error_reset();
+        return NULL;
+    }
+
+    std::map<TSK_OFF_T, TSK_FS_INFO*> filesystems;
+    std::vector<char> buf(EXPORT_READ_SIZE);
+    while (true)
+    {
+        size_t next = __sync_fetch_and_add(&self->m_next, 1);
+        if (next >= self->m_jobs.size())
+            break;
+        if (self->m_deadline && self->m_deadline->expired())
+            break;
+
+        const export_job &job = self->m_jobs[next];
+        std::map<TSK_OFF_T, TSK_FS_INFO*>::iterator it =
+            filesystems.find(job.fsOffset);
+        if (it == filesystems.end())
+        {
+            TSK_FS_INFO *fs = tsk_fs_open_img(img, job.fsOffset,
+                    TSK_FS_TYPE_DETECT);
+            if (fs == NULL)
+                tsk_error_reset();
+            it = filesystems.insert(std::make_pair(job.fsOffset, fs)).first;
+        }
+        if (it->second && self->exportFile(it->second, job, buf))
+            __sync_fetch_and_add(&self->m_exported, 1);
+    }
+
+    for (std::map<TSK_OFF_T, TSK_FS_INFO*>::iterator it =
+            filesystems.begin(); it != filesystems.end(); it++)
+        if (it->second)
+            tsk_fs_close(it->second);
+    tsk_img_close(img);
+    return NULL;
+}
+
+void
+FileExporter::run(int count, const TSK_TCHAR * const *images,
+        TSK_IMG_TYPE_ENUM type, unsigned depth, const Deadline *deadline)
+{
+    TRACE_SCOPE("FileExporter::run");
+    std::sort(m_jobs.begin(), m_jobs.end(), jobOrder);
+    m_next = 0;
+    m_count = count;
+    m_images = images;
+    m_type = type;
+    m_deadline = deadline;
+
+    if (mkdir(m_root.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        std::cerr << "Unable to create " << m_root << std::endl;
+        m_failed += m_jobs.size();
+        return;
+    }
+
+    //only a single raw image maps file system offsets to file offsets
+    TSK_IMG_INFO *img = tsk_img_open(count, images, type, 0);
+    if (img && img->itype == TSK_IMG_TYPE_RAW_SING && count == 1 &&
+            m_imageFd < 0)
+        m_imageFd = open(images[0], O_RDONLY);
+    if (img)
+        tsk_img_close(img);
+    else
+        tsk_error_reset();
+
+    if (depth > m_jobs.size())
+        depth = m_jobs.size();
+    std::vector<pthread_t> workers(depth);
+    std::vector<bool> started(depth, false);
+    for (unsigned t = 0; t < depth; t++)
+        started[t] = (pthread_create(&workers[t], NULL, work, this) == 0);
+    //with no thread to be had, copy on this one
+    if (depth > 0 && !started[0])
+        work(this);
+    for (unsigned t = 0; t < depth; t++)
+        if (started[t])
+            pthread_join(workers[t], NULL);
+
+    //whatever the deadline left is counted as not exported
+    m_failed = m_jobs.size() - m_exported;
+}
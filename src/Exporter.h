@@ -0,0 +1,91 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <tsk3/libtsk.h>
+#include <pthread.h>
+#include <set>
+#include <string>
+#include <vector>
+#include "Deadline.h"
+
+//bytes copied at a time when a file is read through TSK
+#define EXPORT_READ_SIZE    (1024 * 1024)
+
+//a file or log waiting to be copied out
+struct export_job
+{
+    TSK_OFF_T fsOffset;
+    TSK_INUM_T inum;
+    std::string target;
+};
+
+/*
+ * Copies matched files and anomalous logs out of the image into a
+ * directory tree that mirrors their volumes and paths. Objects are
+ * queued while the scan runs and copied by run() in inode order, up to
+ * depth at once, each worker with image and file system handles of its
+ * own. On a single raw image the data runs of plain non-resident files
+ * are copied straight from the image file with copy_file_range(), so
+ * their bytes never pass through user space, with unallocated stretches
+ * left as holes. Anything else is streamed through TSK in large reads.
+ */
+class FileExporter
+{
+    private:
+        std::string m_root;
+        pthread_mutex_t m_lock;
+        std::set<std::string> m_targets;
+        std::vector<export_job> m_jobs;
+        size_t m_next;
+        int m_count;
+        const TSK_TCHAR * const *m_images;
+        TSK_IMG_TYPE_ENUM m_type;
+        int m_imageFd;
+        const Deadline *m_deadline;
+        size_t m_exported;
+        size_t m_failed;
+        //cleared by the first worker copy_file_range() is refused to
+        int m_zeroCopy;
+
+        static void* work(void *arg);
+        bool exportFile(TSK_FS_INFO *fs, const export_job &job,
+                std::vector<char> &buf);
+        bool canCopyRuns(TSK_FS_FILE *file);
+        bool copyRuns(TSK_FS_FILE *file, int out, std::vector<char> &buf);
+        bool copyRange(TSK_OFF_T from, TSK_OFF_T to, TSK_OFF_T length,
+                int out, std::vector<char> &buf);
+        bool copyStream(TSK_FS_FILE *file, int out, std::vector<char> &buf);
+    public:
+        FileExporter(const std::string &root);
+        ~FileExporter();
+        //safe to call from several threads; a path queued twice is
+        //copied once
+        void add(TSK_OFF_T fsOffset, TSK_INUM_T inum,
+                const std::string &volume, const std::string &path,
+                const std::string &name);
+        void run(int count, const TSK_TCHAR * const *images,
+                TSK_IMG_TYPE_ENUM type, unsigned depth,
+                const Deadline *deadline);
+        size_t getQueued() { return m_jobs.size(); }
+        size_t getExported() { return m_exported; }
+        size_t getFailed() { return m_failed; }
+};
+
+#endif
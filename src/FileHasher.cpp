@@ -0,0 +1,221 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FileHasher.h"
+#include <algorithm>
+#include <iostream>
+#include "Spill.h"
+#include "Stats.h"
+#include "Trace.h"
+
+//a file's digests and their node in the map
+#define HASH_ENTRY_BYTES \
+    (sizeof(file_key) + sizeof(file_digests) + 4 * sizeof(void*))
+
+//in the order the files sit in, as near as inodes tell
+static bool jobOrder(const hash_job &a, const hash_job &b)
+{
+    if (a.fsOffset != b.fsOffset)
+        return a.fsOffset < b.fsOffset;
+    return a.inum < b.inum;
+}
+
+FileHasher::FileHasher(unsigned kinds) :
+    m_kinds(kinds), m_next(0), m_count(0), m_images(NULL),
+    m_type(TSK_IMG_TYPE_DETECT), m_deadline(NULL), m_budget(NULL)
+{
+    pthread_mutex_init(&m_lock, NULL);
+}
+
+FileHasher::~FileHasher()
+{
+    if (m_budget)
+        m_budget->release(m_digests.size() * HASH_ENTRY_BYTES +
+                m_jobs.size() * sizeof(hash_job));
+    pthread_mutex_destroy(&m_lock);
+}
+
+void
+FileHasher::add(TSK_OFF_T fsOffset, TSK_INUM_T inum)
+{
+    pthread_mutex_lock(&m_lock);
+    file_digests empty;
+    empty.kinds = 0;
+    std::pair<std::map<file_key, file_digests>::iterator, bool> added =
+        m_digests.insert(std::make_pair(file_key(fsOffset, inum), empty));
+    if (added.second)
+    {
+        hash_job job;
+        job.fsOffset = fsOffset;
+        job.inum = inum;
+        job.digests = &added.first->second;
+        m_jobs.push_back(job);
+        if (m_budget)
+            m_budget->charge(HASH_ENTRY_BYTES + sizeof(hash_job));
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*
+ * Read one file to the end through every hash asked for. Its digests are
+ * only set once all of it was read.
+ */
+void
+FileHasher::hashFile(TSK_FS_INFO *fs, const hash_job &job,
+        std::vector<char> &buf)
+{
+    TSK_FS_FILE *file = tsk_fs_file_open_meta(fs, NULL, job.inum);
+    if (file == NULL || file->meta == NULL)
+    {
+        tsk_error_reset();
+        if (file)
+            tsk_fs_file_close(file);
+        return;
+    }
+
+    Md5 md5;
+    Sha1 sha1;
+    Sha256 sha256;
+    TSK_OFF_T size = file->meta->size;
+    TSK_OFF_T offset = 0;
+    while (offset < size)
+    {
+        ssize_t length = countedFileRead(file, offset, &buf[0], buf.size(),
+                TSK_FS_FILE_READ_FLAG_NONE);
+        if (length <= 0)
+            break;
+
+        ScopedPhase phase(PHASE_HASH);
+        if (m_kinds & HASH_MD5)
+            md5.update(&buf[0], length);
+        if (m_kinds & HASH_SHA1)
+            sha1.update(&buf[0], length);
+        if (m_kinds & HASH_SHA256)
+            sha256.update(&buf[0], length);
+        offset += length;
+    }
+    tsk_fs_file_close(file);
+
+    if (offset < size)
+    {
+        tsk_error_reset();
+        if (tsk_verbose)
+            std::cerr << "Unable to hash inode " << job.inum << std::endl;
+        return;
+    }
+
+    file_digests *digests = job.digests;
+    if (m_kinds & HASH_MD5)
+        md5.final(digests->md5);
+    if (m_kinds & HASH_SHA1)
+        sha1.final(digests->sha1);
+    if (m_kinds & HASH_SHA256)
+        sha256.final(digests->sha256);
+    digests->kinds = m_kinds;
+}
+
+/*
+ * One worker of the pool: takes the next file until none are left,
+ * opening each file system it needs once.
+ */
+void*
+FileHasher::work(void *arg)
+{
+    FileHasher *self = (FileHasher*)arg;
+    TRACE_SCOPE("FileHasher::work");
+
+    TSK_IMG_INFO *img = tsk_img_open(self->m_count, self->m_images,
+            self->m_type, 0);
+    if (img == NULL)
+    {
+        tsk_error_reset();
+        return NULL;
+    }
+
+    std::map<TSK_OFF_T, TSK_FS_INFO*> filesystems;
+    std::vector<char> buf(HASH_READ_SIZE);
+    while (true)
+    {
+        size_t next = __sync_fetch_and_add(&self->m_next, 1);
+        if (next >= self->m_jobs.size())
+            break;
+        if (self->m_deadline && self->m_deadline->expired())
+            break;
+
+        const hash_job &job = self->m_jobs[next];
+        std::map<TSK_OFF_T, TSK_FS_INFO*>::iterator it =
+            filesystems.find(job.fsOffset);
+        if (it == filesystems.end())
+        {
+            TSK_FS_INFO *fs = tsk_fs_open_img(img, job.fsOffset,
+                    TSK_FS_TYPE_DETECT);
+            if (fs == NULL)
+                tsk_error_reset();
+            it = filesystems.insert(std::make_pair(job.fsOffset, fs)).first;
+        }
+        if (it->second)
+            self->hashFile(it->second, job, buf);
+    }
+
+    for (std::map<TSK_OFF_T, TSK_FS_INFO*>::iterator it =
+            filesystems.begin(); it != filesystems.end(); it++)
+        if (it->second)
+            tsk_fs_close(it->second);
+    tsk_img_close(img);
+    return NULL;
+}
+
+void
+FileHasher::run(int count, const TSK_TCHAR * const *images,
+        TSK_IMG_TYPE_ENUM type, unsigned threads, const Deadline *deadline)
+{
+    TRACE_SCOPE("FileHasher::run");
+    std::sort(m_jobs.begin(), m_jobs.end(), jobOrder);
+    m_next = 0;
+    m_count = count;
+    m_images = images;
+    m_type = type;
+    m_deadline = deadline;
+
+    if (threads > m_jobs.size())
+        threads = m_jobs.size();
+    std::vector<pthread_t> workers(threads);
+    std::vector<bool> started(threads, false);
+    for (unsigned t = 0; t < threads; t++)
+        started[t] = (pthread_create(&workers[t], NULL, work, this) == 0);
+    //with no thread to be had, hash on this one
+    if (threads > 0 && !started[0])
+        work(this);
+    for (unsigned t = 0; t < threads; t++)
+        if (started[t])
+            pthread_join(workers[t], NULL);
+
+    //the digests are all that is left to look up
+    if (m_budget)
+        m_budget->release(m_jobs.size() * sizeof(hash_job));
+    std::vector<hash_job>().swap(m_jobs);
+}
+
+const file_digests*
+FileHasher::find(TSK_OFF_T fsOffset, TSK_INUM_T inum)
+{
+    std::map<file_key, file_digests>::iterator it =
+        m_digests.find(file_key(fsOffset, inum));
+    if (it == m_digests.end() || it->second.kinds == 0)
+        return NULL;
+    return &it->second;
+}
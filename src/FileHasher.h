@@ -0,0 +1,85 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILE_HASHER_H
+#define FILE_HASHER_H
+
+#include <tsk3/libtsk.h>
+#include <pthread.h>
+#include <map>
+#include <vector>
+#include "Anomaly.h"
+#include "Deadline.h"
+#include "Digest.h"
+
+//bytes of a file read at a time for hashing
+#define HASH_READ_SIZE      (1024 * 1024)
+
+//a file by its file system offset and inode
+typedef std::pair<TSK_OFF_T, TSK_INUM_T> file_key;
+
+//a matched file waiting to be hashed
+struct hash_job
+{
+    TSK_OFF_T fsOffset;
+    TSK_INUM_T inum;
+    file_digests *digests;
+};
+
+/*
+ * Hashes the content of the files that matched an anomaly window once the
+ * scan is done. Matching queues each file once, however many collections
+ * it falls in. run() hands them out in inode order to a bounded pool of
+ * threads, each with image and file system handles of its own. They read
+ * in large pieces, so one thread's reads overlap the others' hashing.
+ * Files that cannot be read, or are reached after the deadline, are
+ * reported without hashes. Under a memory budget every file queued is
+ * charged until the hasher is destroyed, and its job until run() ends.
+ */
+class FileHasher
+{
+    private:
+        unsigned m_kinds;
+        pthread_mutex_t m_lock;
+        std::map<file_key, file_digests> m_digests;
+        std::vector<hash_job> m_jobs;
+        size_t m_next;
+        int m_count;
+        const TSK_TCHAR * const *m_images;
+        TSK_IMG_TYPE_ENUM m_type;
+        const Deadline *m_deadline;
+        MemoryBudget *m_budget;
+
+        static void* work(void *arg);
+        void hashFile(TSK_FS_INFO *fs, const hash_job &job,
+                std::vector<char> &buf);
+    public:
+        //kinds are hash_flag_t bits
+        FileHasher(unsigned kinds);
+        ~FileHasher();
+        unsigned getKinds() { return m_kinds; }
+        void setBudget(MemoryBudget *budget) { m_budget = budget; }
+        //safe to call from several threads
+        void add(TSK_OFF_T fsOffset, TSK_INUM_T inum);
+        void run(int count, const TSK_TCHAR * const *images,
+                TSK_IMG_TYPE_ENUM type, unsigned threads,
+                const Deadline *deadline);
+        //NULL unless the file was queued and read to the end
+        const file_digests* find(TSK_OFF_T fsOffset, TSK_INUM_T inum);
+};
+
+#endif
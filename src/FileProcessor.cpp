@@ -17,57 +17,172 @@
 
 #include <iostream>
 #include "FileProcessor.h"
+#include "Exporter.h"
+#include "FileHasher.h"
+#include "FileSummary.h"
+#include "MftScanner.h"
+#include "ParallelWalker.h"
+#include "Stats.h"
+#include "Trace.h"
 
-FileProcessor::FileProcessor(std::vector<AnomalyCollection*>* collections)
+FileProcessor::FileProcessor(std::vector<AnomalyCollection*>* collections,
+        pthread_mutex_t *lock) :
+    m_lock(lock), m_volumeOffset(-1), m_mftScan(false), m_threads(1),
+    m_walkCount(0), m_walkImages(NULL), m_walkType(TSK_IMG_TYPE_DETECT),
+    m_deadline(NULL), m_bodyfile(NULL), m_filesScanned(0), m_stopped(false)
 {
     m_collections = collections;
 }
 
+/*
+ * NTFS volumes are handled by the sequential $MFT scanner when enabled;
+ * the directory walk is then skipped for that volume. Other file systems
+ * are walked by the parallel walker when it is enabled. Anything that
+ * cannot be opened that way falls back to the regular walk. Volumes
+ * reached after the deadline are not scanned; the MFT scan and the
+ * parallel walk run to the end once started.
+ */
+TSK_FILTER_ENUM
+FileProcessor::filterFs(TSK_FS_INFO *fs_info)
+{
+    if (m_deadline && m_deadline->expired())
+    {
+        m_stopped = true;
+        return TSK_FILTER_SKIP;
+    }
+
+    if (m_mftScan && TSK_FS_TYPE_ISNTFS(fs_info->ftype))
+    {
+        MftScanner scanner(fs_info, m_threads);
+        if (scanner.scan())
+        {
+            scanner.match(m_collections, m_lock, m_volumeLabel);
+            if (m_bodyfile)
+                scanner.exportRecords(m_bodyfile, m_volumeLabel);
+            m_filesScanned += scanner.getRecordCount();
+            return TSK_FILTER_SKIP;
+        }
+        if (tsk_verbose)
+            std::cerr << "MFT scan failed, walking directories instead"
+                << std::endl;
+    }
+
+    if (m_walkCount > 0 && m_threads > 1)
+    {
+        pthread_mutex_t lock;
+        bool ownLock = (m_lock == NULL);
+        if (ownLock)
+        {
+            pthread_mutex_init(&lock, NULL);
+            m_lock = &lock;
+        }
+
+        ParallelWalker walker(this, fs_info, m_walkCount, m_walkImages,
+                m_walkType, m_threads);
+        bool walked = walker.walk();
+
+        if (ownLock)
+        {
+            m_lock = NULL;
+            pthread_mutex_destroy(&lock);
+        }
+
+        if (walked)
+            return TSK_FILTER_SKIP;
+        if (tsk_verbose)
+            std::cerr << "Parallel walk failed, walking directories instead"
+                << std::endl;
+    }
+
+    return TSK_FILTER_CONT;
+}
+
 TSK_RETVAL_ENUM
 FileProcessor::processFile(TSK_FS_FILE *fs_file, const char *path)
 {
     if (isDotDir(fs_file, path))
         return TSK_OK;
-    else if (isDir(fs_file))
+
+    if (m_deadline && m_deadline->expired())
+    {
+        m_stopped = true;
+        return TSK_STOP;
+    }
+
+    exportFile(fs_file, path);
+    if (isDir(fs_file))
         return TSK_OK;
 
+    TRACE_SCOPE_FILE("FileProcessor::processFile", path, fs_file->name->name);
+    Stats::addFile();
+    matchFile(fs_file, path);
+
+    return TSK_OK;
+}
+
+/*
+ * Add the file to every collection whose anomaly window contains one of
+ * its MAC times, or count it in the collection's summary. Safe to call
+ * from several threads when a lock was given.
+ */
+void
+FileProcessor::matchFile(TSK_FS_FILE *fs_file, const char *path)
+{
+    ScopedPhase phase(PHASE_FILE_MATCH);
+    __sync_fetch_and_add(&m_filesScanned, 1);
+
     if (fs_file->meta)
     {
-        time_t atime = fs_file->meta->atime;
-        time_t mtime = fs_file->meta->mtime;
-        time_t crtime = fs_file->meta->crtime;
+        time_t times[3] = {fs_file->meta->atime, fs_file->meta->mtime,
+            fs_file->meta->crtime};
 
+        TSK_OFF_T offset = fs_file->fs_info->offset;
+        TSK_INUM_T addr = fs_file->name->meta_addr;
+        bool queued = false;
         std::vector<AnomalyCollection*>::iterator it;
         for (it=m_collections->begin(); it != m_collections->end(); it++)
         {
-            if ((atime > (*it)->getPair()->getPreviousAnomaly()->getNextEvent()->getDateCreated() &&
-                atime < (*it)->getPair()->getNextAnomaly()->getPreviousEvent()->getDateCreated()) ||
-                (atime > (*it)->getPair()->getPreviousAnomaly()->getNextEvent()->getDateWritten() &&
-                atime < (*it)->getPair()->getNextAnomaly()->getPreviousEvent()->getDateWritten()) ||
-
-                (mtime > (*it)->getPair()->getPreviousAnomaly()->getNextEvent()->getDateCreated() &&
-                mtime < (*it)->getPair()->getNextAnomaly()->getPreviousEvent()->getDateCreated()) ||
-                (mtime > (*it)->getPair()->getPreviousAnomaly()->getNextEvent()->getDateWritten() &&
-                mtime < (*it)->getPair()->getNextAnomaly()->getPreviousEvent()->getDateWritten()) ||
-
-                (crtime > (*it)->getPair()->getPreviousAnomaly()->getNextEvent()->getDateCreated() &&
-                crtime < (*it)->getPair()->getNextAnomaly()->getPreviousEvent()->getDateCreated()) ||
-                (crtime > (*it)->getPair()->getPreviousAnomaly()->getNextEvent()->getDateWritten() &&
-                crtime < (*it)->getPair()->getNextAnomaly()->getPreviousEvent()->getDateWritten()) )
+            time_t matched[3];
+            size_t count = 0;
+            for (int t = 0; t < 3; t++)
+                if ((*it)->contains(times[t]))
+                    matched[count++] = times[t];
+            if (count == 0)
+                continue;
+
+            FileSummary *summary = (*it)->getSummary();
+            if (m_lock)
+                pthread_mutex_lock(m_lock);
+            if (summary)
+                summary->add(m_volumeLabel, path, fs_file->name->name,
+                        matched, count);
+            else
+                (*it)->addFile(offset, addr, m_volumeLabel.c_str(), path,
+                        fs_file->name->name);
+            if (m_lock)
+                pthread_mutex_unlock(m_lock);
+
+            //hashed and exported once, however many windows it is in
+            if (summary == NULL && !queued)
             {
-                file_info *file = new file_info;
-                file->path = std::string(path);
-                file->name = std::string(fs_file->name->name);
-                (*it)->addFile(file);
+                FileHasher *hasher = (*it)->getHasher();
+                FileExporter *exporter = (*it)->getExporter();
+                if (hasher)
+                    hasher->add(offset, addr);
+                if (exporter)
+                    exporter->add(offset, addr, m_volumeLabel, path,
+                            fs_file->name->name);
+                queued = true;
             }
         }
     }
-
-    return TSK_OK;
 }
 
 bool
 FileProcessor::findAndProcessFiles()
 {
+    ScopedPhase phase(PHASE_FS_WALK);
+    if (m_volumeOffset >= 0)
+        return findFilesInFs(m_volumeOffset);
     return findFilesInImg();
 }
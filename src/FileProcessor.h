@@ -19,18 +19,55 @@
 #define FILE_PROCESSOR_H
 
 #include <tsk3/libtsk.h>
+#include <pthread.h>
+#include <string>
 #include <vector>
 #include "Anomaly.h"
+#include "Bodyfile.h"
+#include "Deadline.h"
 
 class FileProcessor : public TskAuto
 {
     private:
         std::vector<AnomalyCollection*>* m_collections;
+        pthread_mutex_t *m_lock;
+        TSK_OFF_T m_volumeOffset;
+        std::string m_volumeLabel;
+        bool m_mftScan;
+        unsigned m_threads;
+        int m_walkCount;
+        const TSK_TCHAR * const *m_walkImages;
+        TSK_IMG_TYPE_ENUM m_walkType;
+        const Deadline *m_deadline;
+        BodyfileWriter *m_bodyfile;
+        uint64_t m_filesScanned;
+        bool m_stopped;
     public:
-        FileProcessor(std::vector<AnomalyCollection*>* collections);
+        FileProcessor(std::vector<AnomalyCollection*>* collections,
+                pthread_mutex_t *lock = NULL);
         virtual TSK_RETVAL_ENUM processFile
             (TSK_FS_FILE *fs_file, const char *path);
+        virtual TSK_FILTER_ENUM filterFs(TSK_FS_INFO *fs_info);
+        void matchFile(TSK_FS_FILE *fs_file, const char *path);
+        //add a file or directory to the bodyfile, if one is written
+        void exportFile(TSK_FS_FILE *fs_file, const char *path)
+        {
+            if (m_bodyfile)
+                m_bodyfile->addFile(m_volumeLabel, path, fs_file);
+        }
         bool findAndProcessFiles();
+        void setMftScan(bool enabled, unsigned threads)
+            { m_mftScan = enabled; m_threads = threads; }
+        void setParallelWalk(int count, const TSK_TCHAR * const *images,
+                TSK_IMG_TYPE_ENUM type)
+            { m_walkCount = count; m_walkImages = images; m_walkType = type; }
+        void setVolume(TSK_OFF_T offset, const std::string &label)
+            { m_volumeOffset = offset; m_volumeLabel = label; }
+        void setDeadline(const Deadline *deadline) { m_deadline = deadline; }
+        void setBodyfile(BodyfileWriter *bodyfile) { m_bodyfile = bodyfile; }
+        uint64_t getFilesScanned() { return m_filesScanned; }
+        //false if the deadline cut the scan short
+        bool isComplete() { return !m_stopped; }
 };
 
 #endif
@@ -0,0 +1,176 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FileSummary.h"
+#include <math.h>
+#include <algorithm>
+
+TopCounter::TopCounter(size_t capacity) : m_capacity(capacity)
+{
+    m_counters.reserve(capacity);
+}
+
+void
+TopCounter::add(const char *key)
+{
+    std::map<const char*, size_t, cstring_less>::iterator it =
+        m_index.find(key);
+    if (it != m_index.end())
+    {
+        m_counters[it->second].count++;
+        return;
+    }
+
+    if (m_counters.size() < m_capacity)
+    {
+        key_count counter;
+        counter.key = key;
+        counter.count = 1;
+        counter.error = 0;
+        m_counters.push_back(counter);
+        m_index[m_counters.back().key.c_str()] = m_counters.size() - 1;
+        return;
+    }
+
+    size_t smallest = 0;
+    for (size_t c = 1; c < m_counters.size(); c++)
+        if (m_counters[c].count < m_counters[smallest].count)
+            smallest = c;
+
+    key_count &counter = m_counters[smallest];
+    m_index.erase(counter.key.c_str());
+    counter.key = key;
+    counter.error = counter.count;
+    counter.count++;
+    m_index[counter.key.c_str()] = smallest;
+}
+
+static bool countOrder(const key_count &a, const key_count &b)
+{
+    if (a.count != b.count)
+        return a.count > b.count;
+    return a.key < b.key;
+}
+
+std::vector<key_count>
+TopCounter::top(size_t count)
+{
+    std::vector<key_count> counters(m_counters);
+    std::sort(counters.begin(), counters.end(), countOrder);
+    if (counters.size() > count)
+        counters.resize(count);
+    return counters;
+}
+
+//FNV-1a, then mixed so that the top bits are usable on their own
+static uint64_t hashString(const char *s)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (; *s; s++)
+        h = (h ^ (unsigned char)*s) * 1099511628211ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+void
+DistinctCounter::add(const char *s)
+{
+    //the top 10 bits pick the register, the rest give the rank
+    uint64_t h = hashString(s);
+    size_t index = h >> 54;
+    uint64_t rest = (h << 10) | (1ULL << 9);
+    uint8_t rank = __builtin_clzll(rest) + 1;
+    if (rank > m_registers[index])
+        m_registers[index] = rank;
+}
+
+uint64_t
+DistinctCounter::estimate()
+{
+    double m = m_registers.size();
+    double sum = 0;
+    size_t zeros = 0;
+    for (size_t r = 0; r < m_registers.size(); r++)
+    {
+        sum += ldexp(1.0, -m_registers[r]);
+        if (m_registers[r] == 0)
+            zeros++;
+    }
+
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    //small counts are better told by the registers still empty
+    if (estimate <= 2.5 * m && zeros > 0)
+        estimate = m * log(m / zeros);
+    return (uint64_t)(estimate + 0.5);
+}
+
+/*
+ * Buckets are an hour wide, or as many hours as it takes to cover the
+ * window in SUMMARY_BUCKETS of them.
+ */
+FileSummary::FileSummary(time_t start, time_t end) :
+    m_files(0),
+    m_directories(SUMMARY_DIRECTORIES),
+    m_prefixes(SUMMARY_PREFIXES),
+    m_start(start - start % 3600),
+    m_bucketSeconds(3600)
+{
+    time_t span = end > m_start ? end - m_start : 1;
+    time_t hours = (span + 3599) / 3600;
+    m_bucketSeconds =
+        (hours + SUMMARY_BUCKETS - 1) / SUMMARY_BUCKETS * 3600;
+    m_buckets.assign((span + m_bucketSeconds - 1) / m_bucketSeconds, 0);
+}
+
+/*
+ * Count one matching file. times are its MAC times that fell inside the
+ * window; directories are told apart by volume.
+ */
+void
+FileSummary::add(const std::string &volume, const char *path,
+        const char *name, const time_t *times, size_t count)
+{
+    m_files++;
+
+    m_key.clear();
+    if (!volume.empty())
+        m_key.append("[").append(volume).append("] ");
+    size_t base = m_key.size();
+    m_key.append(path);
+    m_directories.add(m_key.c_str());
+    m_distinctDirectories.add(m_key.c_str());
+    m_distinctNames.add(name);
+
+    //the top-level directory, up to its closing slash
+    size_t slash = m_key.find('/', base + 1);
+    if (slash != std::string::npos)
+        m_key.resize(slash + 1);
+    m_prefixes.add(m_key.c_str());
+
+    for (size_t t = 0; t < count; t++)
+    {
+        if (times[t] < m_start)
+            continue;
+        size_t bucket = (times[t] - m_start) / m_bucketSeconds;
+        if (bucket < m_buckets.size())
+            m_buckets[bucket]++;
+    }
+}
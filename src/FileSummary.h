@@ -0,0 +1,110 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILE_SUMMARY_H
+#define FILE_SUMMARY_H
+
+#include <stdint.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "PathPool.h"
+
+#define SUMMARY_DIRECTORIES     256
+#define SUMMARY_PREFIXES        32
+#define SUMMARY_TOP             10
+#define SUMMARY_BUCKETS         168
+#define SUMMARY_REGISTERS       1024
+
+struct key_count
+{
+    std::string key;
+    uint64_t count;
+    //how much count may overstate the key's true count
+    uint64_t error;
+};
+
+/*
+ * The most frequent keys of a stream in a fixed number of counters
+ * (Space-Saving). A new key takes over the smallest counter once all are
+ * in use, so counts of keys that stay are upper bounds off by at most
+ * their error.
+ */
+class TopCounter
+{
+    private:
+        size_t m_capacity;
+        std::vector<key_count> m_counters;
+        //keys point into m_counters, which never reallocates
+        std::map<const char*, size_t, cstring_less> m_index;
+    public:
+        TopCounter(size_t capacity);
+        void add(const char *key);
+        std::vector<key_count> top(size_t count);
+};
+
+/*
+ * Approximate number of distinct strings, in SUMMARY_REGISTERS bytes
+ * (HyperLogLog), to within a few percent.
+ */
+class DistinctCounter
+{
+    private:
+        std::vector<uint8_t> m_registers;
+    public:
+        DistinctCounter() : m_registers(SUMMARY_REGISTERS, 0) {}
+        void add(const char *s);
+        uint64_t estimate();
+};
+
+/*
+ * What the files matching one collection look like, instead of the list
+ * of them: counts per directory and per top-level directory, distinct
+ * directories and names, and a histogram of the matching MAC times over
+ * the anomaly window. Its memory does not grow with the files added.
+ */
+class FileSummary
+{
+    private:
+        uint64_t m_files;
+        TopCounter m_directories;
+        TopCounter m_prefixes;
+        DistinctCounter m_distinctDirectories;
+        DistinctCounter m_distinctNames;
+        time_t m_start;
+        int m_bucketSeconds;
+        std::vector<uint64_t> m_buckets;
+        std::string m_key;
+    public:
+        FileSummary(time_t start, time_t end);
+        void add(const std::string &volume, const char *path,
+                const char *name, const time_t *times, size_t count);
+        uint64_t getFileCount() { return m_files; }
+        std::vector<key_count> getTopDirectories()
+            { return m_directories.top(SUMMARY_TOP); }
+        std::vector<key_count> getPrefixes()
+            { return m_prefixes.top(SUMMARY_PREFIXES); }
+        uint64_t getDistinctDirectories()
+            { return m_distinctDirectories.estimate(); }
+        uint64_t getDistinctNames() { return m_distinctNames.estimate(); }
+        time_t getStart() { return m_start; }
+        int getBucketSeconds() { return m_bucketSeconds; }
+        std::vector<uint64_t> getBuckets() { return m_buckets; }
+};
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDETECTOR_H
+#define IDETECTOR_H
+
+#include <vector>
+#include "ILogParser.h"
+#include "Anomaly.h"
+
+/*
+ * One thing a detector noticed, between an event and the one before it.
+ * The value depends on the detector: records missing for a gap, seconds
+ * between written and created for a divergence, events in the hour for
+ * a rate change, the event ID for a clock event and the threshold pair's
+ * index for a sweep.
+ */
+struct log_finding
+{
+    anomaly_type_t type;
+    LogEvent previous;
+    LogEvent event;
+    int value;
+
+    log_finding(anomaly_type_t t, LogEvent *p, LogEvent *e, int v = 0) :
+        type(t), previous(p), event(e), value(v) {}
+};
+
+//the findings of one log, for the report
+struct log_findings
+{
+    log_location log;
+    std::vector<log_finding> findings;
+};
+
+/*
+ * Looks for one kind of anomaly in a log's event stream. Detectors never
+ * walk the events themselves; a DetectorSet hands each event to all of
+ * them in turn, so any number of detectors costs one pass over the log.
+ */
+class IDetector
+{
+    public:
+        virtual ~IDetector() {}
+        virtual const char* getName() = 0;
+        //a new log starts
+        virtual void reset() {}
+        //event follows previous in the log; previous is NULL for the first
+        virtual void step(LogEvent *previous, LogEvent *event,
+                std::vector<log_finding> &found) = 0;
+        //the log ended with last
+        virtual void finish(LogEvent *last,
+                std::vector<log_finding> &found) {}
+};
+
+#endif
@@ -21,17 +21,61 @@
 #include <tsk3/libtsk.h>
 #include <string>
 #include <vector>
+#include "BlockCache.h"
 
+#define SIGNATURE_SIZE 8
+
+struct log_location
+{
+    std::string path;
+    std::string name;
+    std::string volume;
+};
+
+/*
+ * Where a log was found. Byte-identical copies of it elsewhere in the
+ * image are not parsed again; they are listed as further locations.
+ * Logs are few and their results may outlive the analysis, so each
+ * holds its own strings.
+ */
 class LogInfo
 {
     private:
-        std::string m_path;
-        std::string m_name;
+        log_location m_location;
+        std::vector<log_location> m_copies;
+        //the file system and inode it was read from; -1 if not an image
+        TSK_OFF_T m_fsOffset;
+        TSK_INUM_T m_addr;
+
+        static log_location locate(const std::string &path,
+                const std::string &name, const std::string &volume)
+        {
+            log_location location;
+            location.path = path;
+            location.name = name;
+            location.volume = volume;
+            return location;
+        }
     public:
-        LogInfo (TSK_FS_FILE* fs_file, const char *path) :
-            m_path(path), m_name(fs_file->name->name) {};
-        std::string getPath() { return m_path; }
-        std::string getName() { return m_name; }
+        LogInfo (TSK_FS_FILE* fs_file, const char *path,
+                const std::string &volume = std::string()) :
+            m_location(locate(path, fs_file->name->name, volume)),
+            m_fsOffset(fs_file->fs_info ? fs_file->fs_info->offset : -1),
+            m_addr(fs_file->name->meta_addr) {};
+        LogInfo (const std::string &path, const std::string &name,
+                const std::string &volume = std::string()) :
+            m_location(locate(path, name, volume)),
+            m_fsOffset(-1), m_addr(0) {};
+        std::string getPath() { return m_location.path; }
+        std::string getName() { return m_location.name; }
+        std::string getVolume() { return m_location.volume; }
+        void setAddress(TSK_OFF_T fsOffset, TSK_INUM_T addr)
+            { m_fsOffset = fsOffset; m_addr = addr; }
+        TSK_OFF_T getFsOffset() { return m_fsOffset; }
+        TSK_INUM_T getAddress() { return m_addr; }
+        void addCopy(const LogInfo &copy)
+            { m_copies.push_back(copy.m_location); }
+        std::vector<log_location> getCopies() { return m_copies; }
 };
 
 class LogEvent
@@ -40,27 +84,57 @@ class LogEvent
         int m_dateCreated;
         int m_dateWritten;
         int m_eventId;
+        int m_code;
+        bool m_segment;
     public:
         LogEvent(LogEvent* event) :
             m_eventId(event->getEventId()),
             m_dateCreated(event->getDateCreated()),
-            m_dateWritten(event->getDateWritten()) {}
-        LogEvent(int id, int created, int written) :
-            m_eventId(id), m_dateCreated(created), m_dateWritten(written) {}
+            m_dateWritten(event->getDateWritten()),
+            m_code(event->getEventCode()),
+            m_segment(event->startsSegment()) {}
+        LogEvent(int id, int created, int written, int code = 0) :
+            m_eventId(id), m_dateCreated(created), m_dateWritten(written),
+            m_code(code), m_segment(false) {}
         void setDateCreated(int date) { m_dateCreated = date; }
         void setDateWritten(int date) { m_dateWritten = date; }
         void setEventId(int id) { m_eventId = id; }
         int getDateCreated() { return m_dateCreated; }
         int getDateWritten() { return m_dateWritten; }
         int getEventId() { return m_eventId; }
+        //the event's own ID, such as 520 for a clock change; 0 if unknown
+        int getEventCode() { return m_code; }
+        //the events before it in the log were dropped by a time window,
+        //so it must not be compared with the event kept before it
+        void setStartsSegment(bool segment) { m_segment = segment; }
+        bool startsSegment() { return m_segment; }
 };
 
 class ILogParser
 {
+    protected:
+        //only events near this window are kept, 0 leaves a side open
+        time_t m_since;
+        time_t m_until;
     public:
+        ILogParser() : m_since(0), m_until(0) {}
+        virtual ~ILogParser() {}
+        void setTimeWindow(time_t since, time_t until)
+            { m_since = since; m_until = until; }
         virtual std::vector<LogEvent*> 
-            parseLogFile(TSK_FS_FILE *file, const char *path) = 0;
+            parseLogFile(BlockCache *file, const char *path) = 0;
+        //about count events spread over the log without decoding the
+        //rest, with the file offset of each one's record in offsets
+        virtual std::vector<LogEvent*> sampleLogFile(BlockCache *file,
+                const char *path, size_t count,
+                std::vector<TSK_OFF_T> &offsets) = 0;
+        //the events from the record at start through the one at end, both
+        //offsets taken from sampleLogFile, in log order
+        virtual std::vector<LogEvent*> parseRegion(BlockCache *file,
+                const char *path, TSK_OFF_T start, TSK_OFF_T end) = 0;
         virtual std::string getExtension() = 0;
+        //header is the first SIGNATURE_SIZE bytes of the file
+        virtual bool matchesSignature(const char *header, size_t length) = 0;
 };
 
 #endif
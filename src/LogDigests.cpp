@@ -0,0 +1,131 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LogDigests.h"
+#include <string.h>
+
+bool operator<(const log_digest &a, const log_digest &b)
+{
+    if (a.size != b.size)
+        return a.size < b.size;
+    return memcmp(a.sha256, b.sha256, SHA256_SIZE) < 0;
+}
+
+LogDigests::LogDigests()
+{
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_published, NULL);
+}
+
+LogDigests::~LogDigests()
+{
+    pthread_cond_destroy(&m_published);
+    pthread_mutex_destroy(&m_lock);
+}
+
+/*
+ * Returns true if no log with the head was seen before; the caller must
+ * then parse it and publishHead() its digest. Otherwise waits until the
+ * log with the head has done so, after which the caller hashes its log
+ * in full and claim()s the digest.
+ */
+bool
+LogDigests::claimHead(const log_digest &head)
+{
+    pthread_mutex_lock(&m_lock);
+    std::map<log_digest, bool>::iterator it = m_heads.find(head);
+    if (it == m_heads.end())
+    {
+        m_heads[head] = false;
+        pthread_mutex_unlock(&m_lock);
+        return true;
+    }
+
+    //a head owner never waits, so this always ends
+    while (!it->second)
+        pthread_cond_wait(&m_published, &m_lock);
+    pthread_mutex_unlock(&m_lock);
+    return false;
+}
+
+/*
+ * Records the result of parsing the first log with the head: its full
+ * digest, NULL if it could not be hashed to the end, and the LogInfo its
+ * anomalies were stored under, NULL if it had none.
+ */
+void
+LogDigests::publishHead(const log_digest &head, const log_digest *digest,
+        LogInfo *info)
+{
+    pthread_mutex_lock(&m_lock);
+    if (digest)
+    {
+        digest_entry &entry = m_entries[*digest];
+        entry.published = true;
+        entry.info = info;
+    }
+    m_heads[head] = true;
+    pthread_cond_broadcast(&m_published);
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*
+ * Returns true if this is the first log with the digest, which the caller
+ * must then parse and publish. Otherwise the location is recorded as a
+ * copy of that log.
+ */
+bool
+LogDigests::claim(const log_digest &digest, const LogInfo &location)
+{
+    pthread_mutex_lock(&m_lock);
+    std::map<log_digest, digest_entry>::iterator it = m_entries.find(digest);
+    if (it == m_entries.end())
+    {
+        digest_entry &entry = m_entries[digest];
+        entry.published = false;
+        entry.info = NULL;
+        pthread_mutex_unlock(&m_lock);
+        return true;
+    }
+
+    digest_entry &entry = it->second;
+    if (!entry.published)
+        entry.pending.push_back(location);
+    else if (entry.info != NULL)
+        entry.info->addCopy(location);
+    //a log without anomalies has nothing to list its copies under
+    pthread_mutex_unlock(&m_lock);
+    return false;
+}
+
+/*
+ * Records the result of parsing the first log with the digest: the
+ * LogInfo its anomalies were stored under, or NULL if it had none.
+ */
+void
+LogDigests::publish(const log_digest &digest, LogInfo *info)
+{
+    pthread_mutex_lock(&m_lock);
+    digest_entry &entry = m_entries[digest];
+    entry.published = true;
+    entry.info = info;
+    if (info != NULL)
+        for (size_t i = 0; i < entry.pending.size(); i++)
+            info->addCopy(entry.pending[i]);
+    entry.pending.clear();
+    pthread_mutex_unlock(&m_lock);
+}
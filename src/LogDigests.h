@@ -0,0 +1,76 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOG_DIGESTS_H
+#define LOG_DIGESTS_H
+
+#include <tsk3/libtsk.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include "Digest.h"
+#include "ILogParser.h"
+
+struct log_digest
+{
+    TSK_OFF_T size;
+    uint8_t sha256[SHA256_SIZE];
+};
+
+bool operator<(const log_digest &a, const log_digest &b);
+
+/*
+ * Content digests of the logs parsed so far, shared by every LogProcessor
+ * of one analysis. Only the first log with a given size and SHA-256 is
+ * parsed; later copies become extra locations of its LogInfo. A copy
+ * found while the first is still being parsed on another thread is not
+ * parsed either: it is held in the entry and attached to the first's
+ * LogInfo once that result is published.
+ *
+ * Logs are first keyed by their head, the size and SHA-256 of their
+ * first cache block. A log with a new head is parsed at once and its
+ * full digest taken from the reads of the parse. Only a log whose head
+ * was seen before is hashed in full ahead of parsing, once the log that
+ * head belongs to has published its digest.
+ */
+class LogDigests
+{
+    private:
+        struct digest_entry
+        {
+            bool published;
+            LogInfo *info;
+            std::vector<LogInfo> pending;
+        };
+
+        pthread_mutex_t m_lock;
+        pthread_cond_t m_published;
+        //true once the log with the head has published its digest
+        std::map<log_digest, bool> m_heads;
+        std::map<log_digest, digest_entry> m_entries;
+    public:
+        LogDigests();
+        ~LogDigests();
+        bool claimHead(const log_digest &head);
+        void publishHead(const log_digest &head, const log_digest *digest,
+                LogInfo *info);
+        bool claim(const log_digest &digest, const LogInfo &location);
+        void publish(const log_digest &digest, LogInfo *info);
+};
+
+#endif
@@ -15,101 +15,161 @@
  *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <ctype.h>
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <string>
-#include <algorithm>
 #include "LogProcessor.h"
+#include "LogDigests.h"
+#include "Bodyfile.h"
+#include "Detectors.h"
 #include "EvtLogParser.h"
 #include "EvtxLogParser.h"
+#include "Prefetcher.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "exceptions/Exception.h"
 
-bool hasEnding (std::string const &fullString, std::string const &ending)
+LogProcessor::LogProcessor() :
+    m_volumeOffset(-1),
+    m_prefetcher(NULL),
+    m_cacheBlockSize(DEFAULT_CACHE_BLOCK_SIZE),
+    m_cacheBlocks(DEFAULT_CACHE_BLOCKS),
+    m_sniff(false),
+    m_correlate(false),
+    m_reorder(false),
+    m_detectorFlags(0),
+    m_since(0),
+    m_until(0),
+    m_digests(new LogDigests()),
+    m_ownDigests(true),
+    m_progressive(false),
+    m_triage(0),
+    m_deadline(NULL),
+    m_budget(NULL),
+    m_bodyfile(NULL),
+    m_parseNs(0)
 {
-    std::string lf(fullString);
-    std::string le(ending);
-    
-    std::transform(lf.begin(), lf.end(), lf.begin(), ::tolower);
-    std::transform(le.begin(), le.end(), le.begin(), ::tolower);
-
-    if (lf.length() > le.length())
-        return (0 == lf.compare(
-                     lf.length() - le.length(), 
-                     le.length(),
-                     le));
-    else
-        return false;
+    m_registry.add(new EvtLogParser());
+    m_registry.add(new EvtxLogParser());
 }
 
-LogProcessor::LogProcessor()
+LogProcessor::~LogProcessor()
 {
-    m_parsers.push_back(new EvtLogParser());
-    m_parsers.push_back(new EvtxLogParser());
+    delete m_prefetcher;
+    if (m_ownDigests)
+        delete m_digests;
+    releaseLoggedAnomalies(m_provisional);
+    closeDeferred();
 }
 
-std::vector<Anomaly*> getAnomalies(std::vector<LogEvent*> events)
+void LogProcessor::configureLike(const LogProcessor &other)
 {
-    std::vector<Anomaly*> anomalies;
+    m_cacheBlockSize = other.m_cacheBlockSize;
+    m_cacheBlocks = other.m_cacheBlocks;
+    m_sniff = other.m_sniff;
+    m_correlate = other.m_correlate;
+    m_reorder = other.m_reorder;
+    m_detectorFlags = other.m_detectorFlags;
+    setJumpThresholds(other.m_jumps);
+    setSweep(other.m_sweep.getThresholds());
+    setTimeWindow(other.m_since, other.m_until);
+    m_deadline = other.m_deadline;
+    setMemoryBudget(other.m_budget);
+    m_bodyfile = other.m_bodyfile;
 
-    if (events.size() > 0)
-    {
-        LogEvent* previous = events[0];
-        for (int i = 1; i < events.size(); i++)
-        {
-            LogEvent* next = events[i];
+    //copies are found across all the volumes of an analysis
+    if (m_ownDigests)
+        delete m_digests;
+    m_digests = other.m_digests;
+    m_ownDigests = false;
+}
 
-            //compare to previous
-            if (next->getDateCreated() + BACKWARD_JUMP_DELTA < 
-                    previous->getDateCreated()
-                    || next->getDateWritten() + BACKWARD_JUMP_DELTA < 
-                    previous->getDateWritten())
-            {
-                //add anomaly to list
-                anomalies.push_back(
-                        new Anomaly(BACKWARD_JUMP_ANOMALY, 
-                            new LogEvent(previous), new LogEvent(next)));
-            }
-            else if (next->getDateCreated() - FORWARD_JUMP_DELTA >
-                        previous->getDateCreated() ||
-                        next->getDateWritten() - FORWARD_JUMP_DELTA >
-                        previous->getDateWritten())
-            {
-                anomalies.push_back(
-                        new Anomaly(FORWARD_JUMP_ANOMALY, 
-                            new LogEvent(previous), new LogEvent(next)));
-            }
+void LogProcessor::setTimeWindow(time_t since, time_t until)
+{
+    m_since = since;
+    m_until = until;
+    m_registry.setTimeWindow(since, until);
+}
 
-            //make previous
-            previous = next;
-        }
-    }
+void LogProcessor::setJumpThresholds(const jump_thresholds &jumps)
+{
+    m_jumps = jumps;
+    m_detectorSet.setJumpThresholds(jumps);
+    m_timeline.setJumpThresholds(jumps);
+}
+
+//shared with the timeline, so large merged timelines spill to disk
+void LogProcessor::setMemoryBudget(MemoryBudget *budget)
+{
+    m_budget = budget;
+    m_timeline.setBudget(budget);
+}
 
-    return anomalies;
+void LogProcessor::setSweep(const std::vector<jump_thresholds> &sweep)
+{
+    m_sweep.setThresholds(sweep);
+    m_detectorSet.setSweep(sweep);
 }
 
-std::vector<AnomalyPair*> getPairs(std::vector<Anomaly*> anomalies)
+/*
+ * Pick a parser by the file's leading bytes, for logs that were renamed
+ * or exported without their extension. Only regular files large enough
+ * to hold a signature are read.
+ */
+ILogParser* LogProcessor::sniff(TSK_FS_FILE *fs_file)
 {
-    std::vector<AnomalyPair*> pairs;
+    if (fs_file->meta == NULL ||
+            fs_file->meta->type != TSK_FS_META_TYPE_REG ||
+            fs_file->meta->size < SIGNATURE_SIZE)
+        return NULL;
 
-    if (anomalies.size() > 0)
+    char header[SIGNATURE_SIZE];
+    if (countedFileRead(fs_file, 0, header, SIGNATURE_SIZE,
+                TSK_FS_FILE_READ_FLAG_NONE) != SIGNATURE_SIZE)
     {
-        Anomaly* previous = anomalies[0];
-        for (int i = 1; i < anomalies.size(); i++)
-        {
-            Anomaly* next = anomalies[i];
-            if(previous->getType() != next->getType())
-            {
-                pairs.push_back(
-                        new AnomalyPair(
-                            new Anomaly(previous),
-                            new Anomaly(next)));
-            }
+        tsk_error_reset();
+        return NULL;
+    }
 
-            //make previous
-            previous = next;
-        }
+    return m_registry.bySignature(header, SIGNATURE_SIZE);
+}
+
+/*
+ * Read log data runs ahead of the parser. Only single-file raw images
+ * map file system offsets directly onto the image file, so every other
+ * image type is left alone.
+ */
+bool LogProcessor::enablePrefetch(const TSK_TCHAR *image)
+{
+    if (m_img_info == NULL || m_img_info->itype != TSK_IMG_TYPE_RAW_SING)
+        return false;
+
+    Prefetcher *prefetcher = new Prefetcher();
+    if (!prefetcher->open(image))
+    {
+        delete prefetcher;
+        return false;
     }
 
-    return pairs;
+    delete m_prefetcher;
+    m_prefetcher = prefetcher;
+    return true;
+}
+
+static deferred_log
+deferLog(ILogParser *parser, TSK_FS_FILE *fs_file, const char *path)
+{
+    deferred_log log;
+    log.fsOffset = fs_file->fs_info->offset;
+    log.addr = fs_file->name->meta_addr;
+    log.path = path;
+    log.name = fs_file->name->name;
+    log.size = fs_file->meta ? fs_file->meta->size : 0;
+    log.parser = parser;
+    log.provisional = NULL;
+    return log;
 }
 
 TSK_RETVAL_ENUM 
@@ -120,137 +180,660 @@ LogProcessor::processFile(TSK_FS_FILE* fs_file, const char *path)
     else if (isDir(fs_file))
         return TSK_OK;
 
-    std::string name(fs_file->name->name);
+    //whatever the walk has found by then is all there is to parse
+    if (m_deadline && m_deadline->expired())
+    {
+        m_coverage.walkComplete = false;
+        return TSK_STOP;
+    }
+
+    TRACE_SCOPE_FILE("LogProcessor::processFile", path, fs_file->name->name);
+    Stats::addFile();
+
+    ILogParser *parser = m_registry.byExtension(fs_file->name->name);
+    if (parser == NULL && m_sniff)
+        parser = sniff(fs_file);
+    if (parser != NULL)
+        m_coverage.logsFound++;
 
-    for (int i = 0; i < m_parsers.size(); i++)
+    if (parser != NULL && m_progressive)
+    {
+        BlockCache cache(fs_file, m_cacheBlockSize, m_cacheBlocks);
+        sampleLog(parser, &cache, fs_file, path);
+    }
+    else if (parser != NULL && (m_triage > 0 || m_deadline))
+    {
+        //parsed in order of priority once the walk is done
+        m_deferred.push_back(deferLog(parser, fs_file, path));
+    }
+    else if (parser != NULL)
     {
-        if (hasEnding(name, m_parsers[i]->getExtension()))
+        if (m_prefetcher)
+            m_prefetcher->prefetchFile(fs_file);
+        BlockCache cache(fs_file, m_cacheBlockSize, m_cacheBlocks);
+        processLog(parser, &cache, path);
+        m_coverage.logsParsed++;
+        if (fs_file->meta)
+            m_coverage.bytesParsed += fs_file->meta->size;
+    }
+
+    return TSK_OK;
+}
+
+/*
+ * Parse one log unless a byte-identical copy of it was already parsed,
+ * in which case it is only recorded as another location of that log.
+ * The content is hashed as the parser reads it, within the cache's
+ * capacity; a log is read ahead of its parse only when its first block
+ * matches that of a log seen before.
+ */
+void
+LogProcessor::processLog(ILogParser *parser, BlockCache *cache,
+        const char *path)
+{
+    log_digest head;
+    head.size = cache->getSize();
+    if (!cache->startHash(head.sha256))
+    {
+        //unreadable, so leave it to the parser as it is
+        tsk_error_reset();
+        parseLog(parser, cache, path);
+        return;
+    }
+
+    log_digest digest;
+    digest.size = head.size;
+    LogInfo *info = NULL;
+    if (m_digests->claimHead(head))
+    {
+        try
         {
-            //parse log file
-            std::vector<LogEvent*> events =
-                m_parsers[i]->parseLogFile(fs_file, path);
-            if (tsk_verbose)
-            {
-                std::cerr << "Events found in "
-                    << path
-                    << fs_file->name->name 
-                    << std::endl;
-                for (int i = 0; i < events.size(); i++)
-                {
-                    time_t time = events[i]->getDateCreated();
-                    std::cerr << "id: " << std::setw(8) << std::left 
-                        << events[i]->getEventId() << 
-                        " Event timestamp: " << ctime(&time);
-                }
-            }
+            info = parseLog(parser, cache, path);
+        }
+        catch (...)
+        {
+            m_digests->publishHead(head, NULL, NULL);
+            throw;
+        }
+        bool hashed = cache->finishHash(digest.sha256);
+        if (!hashed)
+            tsk_error_reset();
+        m_digests->publishHead(head, hashed ? &digest : NULL, info);
+        return;
+    }
+
+    if (!cache->finishHash(digest.sha256))
+    {
+        //unreadable to the end, so leave it to the parser as it is
+        tsk_error_reset();
+        parseLog(parser, cache, path);
+        return;
+    }
 
-            //extract anomalies from events
-            std::vector<Anomaly*> anomalies =
-                getAnomalies(events);
+    LogInfo location(path, cache->getName(), m_volumeLabel);
+    if (!m_digests->claim(digest, location))
+    {
+        Stats::addDuplicateLog();
+        if (tsk_verbose)
+            std::cerr << "Skipping " << path << cache->getName()
+                << ", a copy of a log already parsed" << std::endl;
+        return;
+    }
 
-            //delete events
-            while (events.size() > 0)
-            {
-                delete events.back();
-                events.pop_back();
-            }
+    try
+    {
+        info = parseLog(parser, cache, path);
+    }
+    catch (...)
+    {
+        m_digests->publish(digest, NULL);
+        throw;
+    }
+    m_digests->publish(digest, info);
+}
+
+/*
+ * Parse one log, keeping its anomaly pairs if it has any. Returns the
+ * LogInfo they were stored under, or NULL.
+ */
+LogInfo*
+LogProcessor::parseLog(ILogParser *parser, BlockCache *cache,
+        const char *path)
+{
+    //parse log file
+    std::vector<LogEvent*> events =
+        parser->parseLogFile(cache, path);
+
+    if (m_reorder)
+        m_sorter.sort(events);
+
+    if (tsk_verbose)
+    {
+        std::cerr << "Read cache for "
+            << path
+            << cache->getName()
+            << ": " << cache->getHits() << " hits, "
+            << cache->getMisses() << " misses"
+            << std::endl;
+        std::cerr << "Events found in "
+            << path
+            << cache->getName() 
+            << std::endl;
+        for (int i = 0; i < events.size(); i++)
+        {
+            time_t time = events[i]->getDateCreated();
+            std::cerr << "id: " << std::setw(8) << std::left 
+                << events[i]->getEventId() << 
+                " Event timestamp: " << ctime(&time);
+        }
+    }
+
+    //only what survived the time window, and never for skipped copies
+    if (m_bodyfile)
+        for (size_t i = 0; i < events.size(); i++)
+            m_bodyfile->addEvent(m_volumeLabel, path, cache->getName(),
+                    events[i]);
+
+    //the timeline looks for jumps across all logs at once
+    unsigned flags = m_detectorFlags;
+    if (!m_correlate)
+        flags |= DETECT_JUMPS;
+    if (m_reorder)
+        flags |= DETECT_GAPS;
+    //a time window leaves records out on purpose
+    if (m_since != 0 || m_until != 0)
+        flags &= ~DETECT_GAPS;
+    if (!m_sweep.empty())
+        flags |= DETECT_SWEEP;
+    m_detectorSet.configure(flags);
+    m_detectorSet.run(events);
+
+    //jumps make up the anomaly pairs, the rest is reported as found
+    std::vector<Anomaly*> anomalies;
+    log_findings found;
+    for (size_t d = 0; d < m_detectorSet.size(); d++)
+    {
+        std::vector<log_finding> &f = m_detectorSet.getFound(d);
+        if (m_detectorSet.getKind(d) == DETECT_SWEEP)
+        {
+            m_sweep.addLog(LogInfo(path, cache->getName(), m_volumeLabel),
+                    f);
+            continue;
+        }
+        for (size_t i = 0; i < f.size(); i++)
+        {
+            if (f[i].type == BACKWARD_JUMP_ANOMALY ||
+                    f[i].type == FORWARD_JUMP_ANOMALY)
+                anomalies.push_back(new Anomaly(f[i].type,
+                            new LogEvent(&f[i].previous),
+                            new LogEvent(&f[i].event)));
+            else
+                found.findings.push_back(f[i]);
+        }
+    }
+    if (found.findings.size() > 0)
+    {
+        found.log.path = path;
+        found.log.name = cache->getName();
+        found.log.volume = m_volumeLabel;
+        m_findings.push_back(found);
+    }
+
+    if (m_correlate)
+    {
+        //detection waits for every log, see buildCollections()
+        LogInfo *info = describeLog(cache, path);
+        m_timeline.addSource(info, events);
+        return info;
+    }
+
+    //delete events
+    while (events.size() > 0)
+    {
+        delete events.back();
+        events.pop_back();
+    }
+
+    if (tsk_verbose && anomalies.size() > 0)
+    {
+        std::cerr << "Anomalies found in " 
+            << path
+            << cache->getName() 
+            << std::endl;
+        for (int a = 0; a < anomalies.size(); a++)
+        {
+            time_t ptime = 
+                anomalies[a]->getPreviousEvent()->getDateCreated();
+            time_t ntime = 
+                anomalies[a]->getNextEvent()->getDateCreated();
+            std::cerr << "type: " << anomalies[a]->getType() 
+                << std::endl;
+            std::cerr << "\tprev: " << ctime(&ptime);
+            std::cerr << "\tnext: " << ctime(&ntime);
+        }
+    }
+
+    //extact pairs of anomalies
+    std::vector<AnomalyPair*> pairs =
+        getPairs(anomalies);
+
+    releaseAnomalies(anomalies, pairs);
+
+    if (tsk_verbose && pairs.size() > 0)
+        std::cerr << "Anomalious Pairs found in "
+            << path
+            << cache->getName() 
+            << std::endl;
+
+    //Store anomalies if they exist
+    if (pairs.size() == 0)
+        return NULL;
+
+    LogInfo *info = describeLog(cache, path);
+    m_loggedAnomalies.push_back(new LoggedAnomalies(info, pairs));
+    return info;
+}
+
+//where a parsed log was found, with its address if it is in the image
+LogInfo*
+LogProcessor::describeLog(BlockCache *cache, const char *path)
+{
+    LogInfo *info = new LogInfo(path, cache->getName(), m_volumeLabel);
+    TSK_FS_FILE *file = cache->getFile();
+    if (file && file->fs_info && file->meta)
+        info->setAddress(file->fs_info->offset, file->meta->addr);
+    return info;
+}
+
+static void
+deleteEvents(std::vector<LogEvent*> &events)
+{
+    while (events.size() > 0)
+    {
+        delete events.back();
+        events.pop_back();
+    }
+}
+
+/*
+ * Append the jumps between events to anomalies, in order, and the index
+ * of the event after each jump to positions when given.
+ */
+static void
+findJumps(const jump_thresholds &jumps, const std::vector<LogEvent*> &events,
+        std::vector<Anomaly*> &anomalies, std::vector<size_t> *positions)
+{
+    JumpDetector detector(jumps);
+    std::vector<log_finding> found;
+    LogEvent *previous = NULL;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        size_t before = found.size();
+        if (events[i]->startsSegment())
+            previous = NULL;
+        detector.step(previous, events[i], found);
+        if (positions && found.size() > before)
+            positions->push_back(i);
+        previous = events[i];
+    }
+
+    for (size_t f = 0; f < found.size(); f++)
+        anomalies.push_back(new Anomaly(found[f].type,
+                    new LogEvent(&found[f].previous),
+                    new LogEvent(&found[f].event)));
+}
+
+/*
+ * First pass of a progressive scan: decode a sample of the log and keep
+ * the pairs it shows as provisional. The stretches to decode next are
+ * the sample intervals with a jump, widened by one interval each way
+ * since the samples only bound where the jump is.
+ */
+void
+LogProcessor::sampleLog(ILogParser *parser, BlockCache *cache,
+        TSK_FS_FILE *fs_file, const char *path)
+{
+    deferred_log log = deferLog(parser, fs_file, path);
 
-            if (tsk_verbose && anomalies.size() > 0)
+    std::vector<TSK_OFF_T> offsets;
+    std::vector<LogEvent*> samples;
+    try
+    {
+        samples = parser->sampleLogFile(cache, path, SAMPLE_POINTS, offsets);
+    }
+    catch (Exception &e)
+    {
+        //left for the full parse to deal with
+        m_deferred.push_back(log);
+        return;
+    }
+
+    std::vector<Anomaly*> anomalies;
+    std::vector<size_t> positions;
+    findJumps(m_jumps, samples, anomalies, &positions);
+
+    std::vector<std::pair<size_t, size_t> > ranges;
+    for (size_t c = 0; c < positions.size(); c++)
+    {
+        size_t from = positions[c] >= 2 ? positions[c] - 2 : 0;
+        size_t to = std::min(positions[c] + 1, samples.size() - 1);
+        if (!ranges.empty() && from <= ranges.back().second)
+            ranges.back().second = to;
+        else
+            ranges.push_back(std::make_pair(from, to));
+    }
+    for (size_t r = 0; r < ranges.size(); r++)
+        log.regions.push_back(std::make_pair(offsets[ranges[r].first],
+                    offsets[ranges[r].second]));
+
+    std::vector<AnomalyPair*> pairs = getPairs(anomalies);
+    releaseAnomalies(anomalies, pairs);
+    if (pairs.size() > 0)
+    {
+        log.provisional = new LoggedAnomalies(
+                new LogInfo(path, log.name, m_volumeLabel), pairs);
+        m_provisional.push_back(log.provisional);
+    }
+
+    deleteEvents(samples);
+    m_deferred.push_back(log);
+}
+
+//reopen a sampled log by address, opening each file system once
+TSK_FS_FILE*
+LogProcessor::openDeferred(const deferred_log &log)
+{
+    TSK_FS_INFO *&fs = m_filesystems[log.fsOffset];
+    if (fs == NULL)
+        fs = tsk_fs_open_img(m_img_info, log.fsOffset, TSK_FS_TYPE_DETECT);
+    if (fs == NULL)
+        return NULL;
+    return tsk_fs_file_open_meta(fs, NULL, log.addr);
+}
+
+void
+LogProcessor::closeDeferred()
+{
+    std::map<TSK_OFF_T, TSK_FS_INFO*>::iterator it;
+    for (it = m_filesystems.begin(); it != m_filesystems.end(); it++)
+        if (it->second)
+            tsk_fs_close(it->second);
+    m_filesystems.clear();
+}
+
+/*
+ * Second pass of a progressive scan: decode the stretches around each
+ * log's jump candidates and replace its provisional pairs with the ones
+ * they really hold. A log that cannot be read keeps what it had.
+ */
+void
+LogProcessor::refineLogs()
+{
+    TRACE_SCOPE("LogProcessor::refineLogs");
+    std::vector<LoggedAnomalies*> refined;
+    for (size_t l = 0; l < m_deferred.size(); l++)
+    {
+        deferred_log &log = m_deferred[l];
+        if (log.regions.empty())
+            continue;
+        if (m_deadline && m_deadline->expired())
+        {
+            if (log.provisional)
+                refined.push_back(log.provisional);
+            continue;
+        }
+
+        TSK_FS_FILE *fs_file = openDeferred(log);
+        if (fs_file == NULL)
+        {
+            tsk_error_reset();
+            if (log.provisional)
+                refined.push_back(log.provisional);
+            continue;
+        }
+
+        std::vector<Anomaly*> anomalies;
+        bool failed = false;
+        {
+            BlockCache cache(fs_file, m_cacheBlockSize, m_cacheBlocks,
+                    log.name.c_str());
+            try
             {
-                std::cerr << "Anomalies found in " 
-                    << path
-                    << fs_file->name->name 
-                    << std::endl;
-                for (int a = 0; a < anomalies.size(); a++)
+                for (size_t r = 0; r < log.regions.size(); r++)
                 {
-                    time_t ptime = 
-                        anomalies[a]->getPreviousEvent()->getDateCreated();
-                    time_t ntime = 
-                        anomalies[a]->getNextEvent()->getDateCreated();
-                    std::cerr << "type: " << anomalies[a]->getType() 
-                        << std::endl;
-                    std::cerr << "\tprev: " << ctime(&ptime);
-                    std::cerr << "\tnext: " << ctime(&ntime);
+                    std::vector<LogEvent*> events = log.parser->parseRegion(
+                            &cache, log.path.c_str(), log.regions[r].first,
+                            log.regions[r].second);
+                    findJumps(m_jumps, events, anomalies, NULL);
+                    deleteEvents(events);
                 }
             }
-
-            //extact pairs of anomalies
-            std::vector<AnomalyPair*> pairs =
-                getPairs(anomalies);
-
-            //delete anomalies
-            while (anomalies.size() > 0)
+            catch (Exception &e)
             {
-                delete anomalies.back();
-                anomalies.pop_back();
+                failed = true;
             }
+        }
+        tsk_fs_file_close(fs_file);
 
-            if (tsk_verbose && pairs.size() > 0)
-                std::cerr << "Anomalious Pairs found in "
-                    << path
-                    << fs_file->name->name 
-                    << std::endl;
+        std::vector<AnomalyPair*> pairs;
+        if (!failed)
+            pairs = getPairs(anomalies);
+        releaseAnomalies(anomalies, pairs);
+        if (failed)
+        {
+            if (log.provisional)
+                refined.push_back(log.provisional);
+            continue;
+        }
 
-            //Store anomalies if they exist
-            if (pairs.size() > 0)
-            {
-                std::string strname(fs_file->name->name);
-                std::string strpath(path);
-                m_loggedAnomalies.push_back(
-                        new LoggedAnomalies(
-                            new LogInfo(fs_file, path), 
-                            pairs));
-                //LogInfo li(fs_file, path);
-                //std::cout << "LogInfo: " << li.getPath() << li.getName()
-                    //<< std::endl;
-            }
+        if (log.provisional)
+            releaseLoggedAnomalies(
+                    std::vector<LoggedAnomalies*>(1, log.provisional));
+        log.provisional = NULL;
+        if (pairs.size() > 0)
+        {
+            log.provisional = new LoggedAnomalies(
+                    new LogInfo(log.path, log.name, m_volumeLabel), pairs);
+            refined.push_back(log.provisional);
         }
     }
+    m_provisional = refined;
+}
 
-    return TSK_OK;
+//the logs a clock change shows up in first, for triage
+static int triagePriority(const std::string &name)
+{
+    static const char *logs[] = {
+        "system.evtx", "sysevent.evt",
+        "security.evtx", "secevent.evt",
+        "application.evtx", "appevent.evt"
+    };
+    std::string lower(name);
+    for (size_t i = 0; i < lower.length(); i++)
+        lower[i] = tolower(lower[i]);
+    for (size_t i = 0; i < sizeof(logs) / sizeof(logs[0]); i++)
+        if (lower == logs[i])
+            return i / 2;
+    return sizeof(logs) / sizeof(logs[0]) / 2;
 }
 
-bool LogProcessor::findAndProcessLogs()
+static bool triageOrder(const deferred_log &a, const deferred_log &b)
 {
-    bool result = findFilesInImg();
+    return triagePriority(a.name) < triagePriority(b.name);
+}
 
-    m_collections.clear();
+/*
+ * Expected value per byte for a time-budgeted scan: the logs a clock
+ * change shows up in first are worth more, and every byte costs time,
+ * so small system logs lead and large archived ones come last.
+ */
+static bool valueOrder(const deferred_log &a, const deferred_log &b)
+{
+    uint64_t valueA = 4 - triagePriority(a.name);
+    uint64_t valueB = 4 - triagePriority(b.name);
+    return valueA * (b.size + 1) > valueB * (a.size + 1);
+}
 
-    if (!result)
+/*
+ * Whether the log can be parsed before the deadline, going by how fast
+ * the logs before it were. The first one is always tried.
+ */
+bool
+LogProcessor::fitsDeadline(const deferred_log &log)
+{
+    if (m_deadline->expired())
+        return false;
+    if (m_coverage.bytesParsed == 0)
+        return true;
+    double rate = (double)m_parseNs / m_coverage.bytesParsed;
+    return m_deadline->allows((uint64_t)(rate * log.size));
+}
+
+//whether m_triage different logs agree on one collection
+bool
+LogProcessor::corroborated()
+{
+    std::vector<AnomalyCollection*> collections =
+        collectAnomalies(m_loggedAnomalies);
+    bool found = false;
+    for (size_t i = 0; i < collections.size(); i++)
+        if (collections[i]->getLogCount() >= m_triage)
+            found = true;
+    releaseCollections(collections);
+    return found;
+}
+
+/*
+ * Last pass of a progressive, triage or time-budgeted scan: parse the
+ * deferred logs in full, as a plain scan would have, in place of any
+ * provisional results. A triage scan takes the logs a clock change shows
+ * up in first and stops as soon as m_triage of them agree on an anomaly.
+ * With a deadline the logs go by value per byte instead, and any that
+ * would not be done in time are skipped and counted as such.
+ */
+void
+LogProcessor::processDeferredLogs()
+{
+    TRACE_SCOPE("LogProcessor::processDeferredLogs");
+    releaseLoggedAnomalies(m_provisional);
+    m_provisional.clear();
+
+    std::vector<deferred_log> deferred;
+    deferred.swap(m_deferred);
+    if (m_deadline)
+        std::stable_sort(deferred.begin(), deferred.end(), valueOrder);
+    else if (m_triage > 0)
+        std::stable_sort(deferred.begin(), deferred.end(), triageOrder);
+    for (size_t l = 0; l < deferred.size(); l++)
     {
-        for (int i = 0; i < m_loggedAnomalies.size(); i++)
+        if (m_deadline && !fitsDeadline(deferred[l]))
         {
-            for (int p = 0; p < m_loggedAnomalies[i]->getPairs().size(); p++)
-            {
-
-                bool found = false;
+            m_coverage.logsSkipped++;
+            m_coverage.bytesSkipped += deferred[l].size;
+            continue;
+        }
 
-                for (int a = 0; a < m_collections.size(); a++)
-                {
-                    if (m_loggedAnomalies[i]->getPairs()[p]->intersects(
-                                m_collections[a]->getPair()))
-                    {
-                        m_collections[a]->addLog(new LoggedAnomaly(
-                                    m_loggedAnomalies[i]->getLogInfo(),
-                                    m_loggedAnomalies[i]->getPairs()[p]));
-                        found = true;
-                        break;
-                    }
-                }
+        TSK_FS_FILE *fs_file = openDeferred(deferred[l]);
+        if (fs_file == NULL)
+        {
+            if (tsk_verbose)
+                std::cerr << "Unable to reopen " << deferred[l].path
+                    << deferred[l].name << std::endl;
+            tsk_error_reset();
+            continue;
+        }
 
-                if (!found)
-                {
-                    AnomalyCollection *c = new AnomalyCollection();
-                    c->setPair(m_loggedAnomalies[i]->getPairs()[p]);
-                    c->addLog(new LoggedAnomaly(
-                                m_loggedAnomalies[i]->getLogInfo(),
-                                m_loggedAnomalies[i]->getPairs()[p]));
-                    m_collections.push_back(c);
-                }
+        size_t logged = m_loggedAnomalies.size();
+        uint64_t started = monotonicNs();
+        if (m_prefetcher)
+            m_prefetcher->prefetchFile(fs_file);
+        try
+        {
+            BlockCache cache(fs_file, m_cacheBlockSize, m_cacheBlocks,
+                    deferred[l].name.c_str());
+            processLog(deferred[l].parser, &cache, deferred[l].path.c_str());
+        }
+        catch (...)
+        {
+            tsk_fs_file_close(fs_file);
+            closeDeferred();
+            throw;
+        }
+        tsk_fs_file_close(fs_file);
+        m_parseNs += monotonicNs() - started;
+        m_coverage.logsParsed++;
+        m_coverage.bytesParsed += deferred[l].size;
 
+        if (m_triage > 0 && m_loggedAnomalies.size() > logged &&
+                corroborated())
+        {
+            if (tsk_verbose)
+                std::cerr << "Triage: " << m_triage << " logs agree, "
+                    << deferred.size() - l - 1 << " logs left unparsed"
+                    << std::endl;
+            for (l++; l < deferred.size(); l++)
+            {
+                m_coverage.logsSkipped++;
+                m_coverage.bytesSkipped += deferred[l].size;
             }
+            break;
         }
     }
-    
+    closeDeferred();
+}
+
+/*
+ * Parse a log held in memory, chosen by name or, with sniffing on, by
+ * its signature. Returns false if no parser takes it.
+ */
+bool
+LogProcessor::processBuffer(const char *name, const char *data,
+        size_t length, const char *path)
+{
+    ILogParser *parser = m_registry.byExtension(name);
+    if (parser == NULL && m_sniff && length >= SIGNATURE_SIZE)
+        parser = m_registry.bySignature(data, SIGNATURE_SIZE);
+    if (parser == NULL)
+        return false;
+
+    BlockCache cache(data, length, name);
+    processLog(parser, &cache, path);
+    return true;
+}
+
+/*
+ * Walk the image or volume for logs without building collections, for
+ * processors whose results are merged into another.
+ */
+bool LogProcessor::findLogs()
+{
+    TRACE_SCOPE("LogProcessor::findLogs");
+    ScopedPhase phase(PHASE_FS_WALK);
+    if (m_volumeOffset >= 0)
+        return findFilesInFs(m_volumeOffset);
+    return findFilesInImg();
+}
+
+bool LogProcessor::findAndProcessLogs()
+{
+    bool result = findLogs();
+
+    if (!result)
+        buildCollections();
+
     return result;
 }
+
+void LogProcessor::buildCollections()
+{
+    ScopedPhase phase(PHASE_MERGE);
+
+    if (!m_timeline.empty())
+    {
+        std::vector<LoggedAnomalies*> found = m_timeline.detect();
+        m_loggedAnomalies.insert(m_loggedAnomalies.end(),
+                found.begin(), found.end());
+    }
+
+    m_collections = collectAnomalies(m_loggedAnomalies);
+}
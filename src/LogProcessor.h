@@ -19,27 +19,146 @@
 #define LOG_PROCESSOR_H
 
 #include <tsk3/libtsk.h>
+#include <map>
 #include <vector>
 #include <string>
 
 #include "ILogParser.h"
 #include "Anomaly.h"
+#include "ParserRegistry.h"
+#include "Timeline.h"
+#include "RecordSorter.h"
+#include "DetectorSet.h"
+#include "Sweep.h"
+#include "Deadline.h"
+
+#define SAMPLE_POINTS   64
+
+class Prefetcher;
+class LogDigests;
+class BodyfileWriter;
+
+//a log found by the walk of a progressive, triage or time-budgeted scan,
+//parsed later
+struct deferred_log
+{
+    TSK_OFF_T fsOffset;
+    TSK_INUM_T addr;
+    std::string path;
+    std::string name;
+    TSK_OFF_T size;
+    ILogParser *parser;
+    //the pairs its samples, then its decoded stretches, show; or NULL
+    LoggedAnomalies *provisional;
+    //record offsets bounding the stretches around jump candidates
+    std::vector<std::pair<TSK_OFF_T, TSK_OFF_T> > regions;
+};
 
 class LogProcessor : public TskAuto
 {
     public:
         LogProcessor();
+        ~LogProcessor();
         virtual TSK_RETVAL_ENUM processFile
             (TSK_FS_FILE* fs_file, const char *path);
         bool findAndProcessLogs();
+        bool findLogs();
+        bool processBuffer(const char *name, const char *data, size_t length,
+                const char *path = "");
+        void setVolume(TSK_OFF_T offset, const std::string &label)
+            { m_volumeOffset = offset; m_volumeLabel = label; }
+        void configureLike(const LogProcessor &other);
+        void addLoggedAnomalies(const std::vector<LoggedAnomalies*> &logged)
+        {
+            m_loggedAnomalies.insert(m_loggedAnomalies.end(),
+                    logged.begin(), logged.end());
+        }
+        void buildCollections();
         std::vector<LoggedAnomalies*> getLoggedAnomalies() 
             { return m_loggedAnomalies; };
         std::vector<AnomalyCollection*> getAnomalyCollections()
             { return m_collections; }
+        void setReadCache(size_t blockSize, size_t blocks)
+            { m_cacheBlockSize = blockSize; m_cacheBlocks = blocks; }
+        bool enablePrefetch(const TSK_TCHAR *image);
+        void setSniff(bool sniff) { m_sniff = sniff; }
+        void setCorrelate(bool correlate) { m_correlate = correlate; }
+        void setReorder(bool reorder) { m_reorder = reorder; }
+        void setDetectors(unsigned flags) { m_detectorFlags = flags; }
+        void setJumpThresholds(const jump_thresholds &jumps);
+        void setSweep(const std::vector<jump_thresholds> &sweep);
+        void takeSweep(LogProcessor *other) { m_sweep.take(other->m_sweep); }
+        std::vector<sweep_result> getSweepResults()
+            { return m_sweep.getResults(); }
+        void addFindings(const std::vector<log_findings> &findings)
+        {
+            m_findings.insert(m_findings.end(),
+                    findings.begin(), findings.end());
+        }
+        std::vector<log_findings> getFindings() { return m_findings; }
+        void takeTimeline(LogProcessor *other)
+            { m_timeline.takeSources(other->m_timeline); }
+        void setTimeWindow(time_t since, time_t until);
+        void setProgressive(bool progressive)
+            { m_progressive = progressive; }
+        std::vector<AnomalyCollection*> getProvisionalCollections()
+            { return collectAnomalies(m_provisional); }
+        void setTriage(unsigned logs) { m_triage = logs; }
+        void refineLogs();
+        void processDeferredLogs();
+        void setDeadline(const Deadline *deadline) { m_deadline = deadline; }
+        scan_coverage getCoverage() { return m_coverage; }
+        void addCoverage(const scan_coverage &coverage)
+            { m_coverage.add(coverage); }
+        void setMemoryBudget(MemoryBudget *budget);
+        void setBodyfile(BodyfileWriter *bodyfile) { m_bodyfile = bodyfile; }
     private:
+        TSK_OFF_T m_volumeOffset;
+        std::string m_volumeLabel;
+        Prefetcher *m_prefetcher;
+        size_t m_cacheBlockSize;
+        size_t m_cacheBlocks;
         std::vector<AnomalyCollection*> m_collections;
         std::vector<LoggedAnomalies*> m_loggedAnomalies;
-        std::vector<ILogParser*> m_parsers;
+        ParserRegistry m_registry;
+        bool m_sniff;
+        bool m_correlate;
+        Timeline m_timeline;
+        bool m_reorder;
+        RecordSorter m_sorter;
+        unsigned m_detectorFlags;
+        DetectorSet m_detectorSet;
+        std::vector<log_findings> m_findings;
+        jump_thresholds m_jumps;
+        Sweep m_sweep;
+        time_t m_since;
+        time_t m_until;
+        LogDigests *m_digests;
+        bool m_ownDigests;
+        bool m_progressive;
+        unsigned m_triage;
+        std::vector<deferred_log> m_deferred;
+        std::vector<LoggedAnomalies*> m_provisional;
+        std::map<TSK_OFF_T, TSK_FS_INFO*> m_filesystems;
+        const Deadline *m_deadline;
+        MemoryBudget *m_budget;
+        BodyfileWriter *m_bodyfile;
+        scan_coverage m_coverage;
+        //time spent parsing deferred logs, for estimating the rest
+        uint64_t m_parseNs;
+
+        ILogParser* sniff(TSK_FS_FILE *fs_file);
+        void processLog(ILogParser *parser, BlockCache *cache,
+                const char *path);
+        LogInfo* parseLog(ILogParser *parser, BlockCache *cache,
+                const char *path);
+        LogInfo* describeLog(BlockCache *cache, const char *path);
+        void sampleLog(ILogParser *parser, BlockCache *cache,
+                TSK_FS_FILE *fs_file, const char *path);
+        TSK_FS_FILE* openDeferred(const deferred_log &log);
+        bool corroborated();
+        bool fitsDeadline(const deferred_log &log);
+        void closeDeferred();
 };
 
 #endif
@@ -0,0 +1,612 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MftScanner.h"
+#include <iostream>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include "Exporter.h"
+#include "FileHasher.h"
+#include "Stats.h"
+#include "Trace.h"
+
+#define NTFS_EPOCH_DIFF     0x019DB1DED53E8000LL
+#define NTFS_RATE_DIFF      10000000
+#define NTFS_ROOT_RECORD    5
+#define NTFS_REF_MASK       0x0000FFFFFFFFFFFFULL
+#define NTFS_SECTOR_SIZE    512
+#define NTFS_MAX_DEPTH      256
+
+#define ATTR_STANDARD_INFORMATION   0x10
+#define ATTR_FILE_NAME              0x30
+#define ATTR_END                    0xFFFFFFFF
+
+#define FN_NAMESPACE_DOS    2
+
+struct decode_job
+{
+    MftScanner *scanner;
+    char *buf;
+    uint64_t first;
+    size_t count;
+};
+
+static uint16_t le16(const char *p)
+{
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t le32(const char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t le64(const char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/* Convert an NTFS FILETIME into UNIX seconds, clamped to a LogEvent date */
+static int32_t ntfsTime(const char *p)
+{
+    int64_t t = ((int64_t)le64(p) - NTFS_EPOCH_DIFF) / NTFS_RATE_DIFF;
+    if (t < INT_MIN)
+        return INT_MIN;
+    if (t > INT_MAX)
+        return INT_MAX;
+    return (int32_t)t;
+}
+
+/*
+ * Verify and undo the update sequence array. Returns false for records
+ * that are not in use, torn or otherwise corrupt.
+ */
+static bool applyFixups(char *rec, uint32_t size)
+{
+    if (memcmp(rec, "FILE", 4) != 0)
+        return false;
+
+    uint16_t usa_offset = le16(rec + 0x04);
+    uint16_t usa_count = le16(rec + 0x06);
+    if (usa_count == 0 || usa_offset + usa_count * 2 > size ||
+            (uint32_t)(usa_count - 1) * NTFS_SECTOR_SIZE > size)
+        return false;
+
+    const char *usa = rec + usa_offset;
+    for (uint16_t i = 1; i < usa_count; i++)
+    {
+        char *tail = rec + i * NTFS_SECTOR_SIZE - 2;
+        if (memcmp(tail, usa, 2) != 0)
+            return false;
+        memcpy(tail, usa + i * 2, 2);
+    }
+
+    return true;
+}
+
+/*
+ * Find the resident content of the preferred $FILE_NAME attribute. Long
+ * (Win32/POSIX) names win over DOS 8.3 names.
+ */
+static const char* findFileName(const char *rec, uint32_t size)
+{
+    const char *found = NULL;
+    uint32_t offset = le16(rec + 0x14);
+    while (offset + 16 <= size)
+    {
+        const char *attr = rec + offset;
+        uint32_t type = le32(attr);
+        uint32_t length = le32(attr + 4);
+        if (type == ATTR_END || length == 0 || offset + length > size)
+            break;
+
+        if (type == ATTR_FILE_NAME && attr[8] == 0)
+        {
+            uint32_t content_size = le32(attr + 0x10);
+            uint16_t content_offset = le16(attr + 0x14);
+            const char *content = attr + content_offset;
+            if (content_offset + content_size <= length &&
+                    content_size >= 66 &&
+                    66 + (uint32_t)(uint8_t)content[64] * 2 <= content_size)
+            {
+                if (content[65] != FN_NAMESPACE_DOS)
+                    return content;
+                if (found == NULL)
+                    found = content;
+            }
+        }
+
+        offset += length;
+    }
+
+    return found;
+}
+
+static std::string utf16ToUtf8(const char *p, size_t chars)
+{
+    std::string out;
+    for (size_t i = 0; i < chars; i++)
+    {
+        uint32_t c = le16(p + i * 2);
+        if (c >= 0xD800 && c < 0xDC00 && i + 1 < chars)
+        {
+            uint32_t low = le16(p + (i + 1) * 2);
+            if (low >= 0xDC00 && low < 0xE000)
+            {
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            }
+        }
+
+        if (c < 0x80)
+            out += (char)c;
+        else if (c < 0x800)
+        {
+            out += (char)(0xC0 | (c >> 6));
+            out += (char)(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000)
+        {
+            out += (char)(0xE0 | (c >> 12));
+            out += (char)(0x80 | ((c >> 6) & 0x3F));
+            out += (char)(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            out += (char)(0xF0 | (c >> 18));
+            out += (char)(0x80 | ((c >> 12) & 0x3F));
+            out += (char)(0x80 | ((c >> 6) & 0x3F));
+            out += (char)(0x80 | (c & 0x3F));
+        }
+    }
+    return out;
+}
+
+static void* decodeSlice(void *arg)
+{
+    decode_job *job = (decode_job*)arg;
+    ScopedPhase phase(PHASE_DECODE);
+    job->scanner->decodeRecords(job->buf, job->first, job->count);
+    return NULL;
+}
+
+MftScanner::MftScanner(TSK_FS_INFO *fs, unsigned threads) :
+    m_fs(fs), m_mft(NULL), m_threads(threads > 0 ? threads : 1),
+    m_recordSize(0), m_recordCount(0)
+{
+}
+
+MftScanner::~MftScanner()
+{
+    if (m_mft)
+        tsk_fs_file_close(m_mft);
+}
+
+bool
+MftScanner::readRecordSize()
+{
+    char boot[NTFS_SECTOR_SIZE];
+    if (tsk_img_read(m_fs->img_info, m_fs->offset, boot, sizeof(boot)) !=
+            sizeof(boot))
+        return false;
+    if (memcmp(boot + 3, "NTFS    ", 8) != 0)
+        return false;
+
+    uint32_t sector_size = le16(boot + 0x0B);
+    uint32_t cluster_size = sector_size * (uint8_t)boot[0x0D];
+    int8_t clusters = (int8_t)boot[0x40];
+
+    if (clusters > 0)
+        m_recordSize = clusters * cluster_size;
+    else if (clusters > -31)
+        m_recordSize = 1U << -clusters;
+
+    return m_recordSize >= NTFS_SECTOR_SIZE && m_recordSize <= 65536 &&
+        m_recordSize % NTFS_SECTOR_SIZE == 0;
+}
+
+void
+MftScanner::decodeRecords(char *buf, uint64_t first, size_t count)
+{
+    for (size_t r = 0; r < count; r++)
+    {
+        char *rec = buf + r * m_recordSize;
+        uint64_t index = first + r;
+        m_columns.flags[index] = 0;
+
+        if (!applyFixups(rec, m_recordSize))
+            continue;
+
+        uint8_t flags = 0;
+        bool dos_name = false;
+        uint16_t record_flags = le16(rec + 0x16);
+        if (record_flags & 0x01)
+            flags |= MFT_RECORD_IN_USE;
+        if (record_flags & 0x02)
+            flags |= MFT_RECORD_DIRECTORY;
+        if ((le64(rec + 0x20) & NTFS_REF_MASK) != 0)
+            flags |= MFT_RECORD_EXTENSION;
+
+        uint32_t offset = le16(rec + 0x14);
+        while (offset + 16 <= m_recordSize)
+        {
+            const char *attr = rec + offset;
+            uint32_t type = le32(attr);
+            uint32_t length = le32(attr + 4);
+            if (type == ATTR_END || length == 0 ||
+                    offset + length > m_recordSize)
+                break;
+            offset += length;
+
+            //both attributes are always resident
+            if (attr[8] != 0)
+                continue;
+
+            uint32_t content_size = le32(attr + 0x10);
+            uint16_t content_offset = le16(attr + 0x14);
+            const char *content = attr + content_offset;
+            if (content_offset + content_size > length)
+                continue;
+
+            if (type == ATTR_STANDARD_INFORMATION && content_size >= 32 &&
+                    !(flags & MFT_RECORD_HAS_SI))
+            {
+                m_columns.si_crtime[index] = ntfsTime(content);
+                m_columns.si_mtime[index] = ntfsTime(content + 8);
+                m_columns.si_ctime[index] = ntfsTime(content + 16);
+                m_columns.si_atime[index] = ntfsTime(content + 24);
+                flags |= MFT_RECORD_HAS_SI;
+            }
+            else if (type == ATTR_FILE_NAME && content_size >= 66 &&
+                    (!(flags & MFT_RECORD_HAS_FN) || dos_name))
+            {
+                //same preference as findFileName(): first long name wins
+                dos_name = (content[65] == FN_NAMESPACE_DOS);
+                m_columns.parent[index] = le64(content) & NTFS_REF_MASK;
+                m_columns.fn_crtime[index] = ntfsTime(content + 8);
+                m_columns.fn_mtime[index] = ntfsTime(content + 16);
+                m_columns.fn_ctime[index] = ntfsTime(content + 24);
+                m_columns.fn_atime[index] = ntfsTime(content + 32);
+                flags |= MFT_RECORD_HAS_FN;
+            }
+        }
+
+        m_columns.flags[index] = flags;
+    }
+}
+
+bool
+MftScanner::scan()
+{
+    TRACE_SCOPE("MftScanner::scan");
+
+    if (!readRecordSize())
+        return false;
+
+    m_mft = tsk_fs_file_open_meta(m_fs, NULL, 0);
+    if (m_mft == NULL || m_mft->meta == NULL)
+    {
+        tsk_error_reset();
+        return false;
+    }
+
+    m_recordCount = m_mft->meta->size / m_recordSize;
+    m_columns.flags.assign(m_recordCount, 0);
+    m_columns.parent.resize(m_recordCount);
+    m_columns.si_crtime.resize(m_recordCount);
+    m_columns.si_mtime.resize(m_recordCount);
+    m_columns.si_atime.resize(m_recordCount);
+    m_columns.si_ctime.resize(m_recordCount);
+    m_columns.fn_crtime.resize(m_recordCount);
+    m_columns.fn_mtime.resize(m_recordCount);
+    m_columns.fn_atime.resize(m_recordCount);
+    m_columns.fn_ctime.resize(m_recordCount);
+
+    //double buffered: read the next chunk while the workers decode
+    size_t chunk_size = (size_t)MFT_CHUNK_RECORDS * m_recordSize;
+    std::vector<char> buffers[2];
+    buffers[0].resize(chunk_size);
+    buffers[1].resize(chunk_size);
+
+    time_t start = time(NULL);
+    uint64_t first = 0;
+    int current = 0;
+    ssize_t length = countedFileRead(m_mft, 0, &buffers[0][0], chunk_size,
+            TSK_FS_FILE_READ_FLAG_NONE);
+
+    while (length > 0 && first < m_recordCount)
+    {
+        size_t count = length / m_recordSize;
+        if (count > m_recordCount - first)
+            count = m_recordCount - first;
+        if (count == 0)
+            break;
+
+        std::vector<decode_job> jobs(m_threads);
+        std::vector<pthread_t> threads(m_threads);
+        std::vector<bool> started(m_threads, false);
+        size_t slice = (count + m_threads - 1) / m_threads;
+        for (unsigned t = 0; t < m_threads; t++)
+        {
+            size_t begin = t * slice;
+            jobs[t].scanner = this;
+            jobs[t].buf = &buffers[current][0] + begin * m_recordSize;
+            jobs[t].first = first + begin;
+            jobs[t].count = begin < count ?
+                (count - begin < slice ? count - begin : slice) : 0;
+            if (jobs[t].count > 0 && m_threads > 1)
+                started[t] = (pthread_create(&threads[t], NULL,
+                            decodeSlice, &jobs[t]) == 0);
+        }
+
+        uint64_t next = first + count;
+        ssize_t next_length = 0;
+        if (next < m_recordCount)
+            next_length = countedFileRead(m_mft, next * m_recordSize,
+                    &buffers[1 - current][0], chunk_size,
+                    TSK_FS_FILE_READ_FLAG_NONE);
+
+        for (unsigned t = 0; t < m_threads; t++)
+        {
+            if (started[t])
+                pthread_join(threads[t], NULL);
+            else if (jobs[t].count > 0)
+                decodeSlice(&jobs[t]);
+        }
+        Stats::addRecords(count);
+
+        first = next;
+        length = next_length;
+        current = 1 - current;
+    }
+
+    if (tsk_verbose)
+    {
+        time_t elapsed = time(NULL) - start;
+        std::cerr << "MftScanner: decoded " << first << " records of "
+            << m_recordSize << " bytes in " << elapsed << "s using "
+            << m_threads << " threads" << std::endl;
+    }
+
+    return first > 0;
+}
+
+bool
+MftScanner::readRecord(uint64_t record, std::vector<char> &buf)
+{
+    buf.resize(m_recordSize);
+    if (countedFileRead(m_mft, record * m_recordSize, &buf[0], m_recordSize,
+                TSK_FS_FILE_READ_FLAG_NONE) != (ssize_t)m_recordSize)
+        return false;
+    return applyFixups(&buf[0], m_recordSize);
+}
+
+std::string
+MftScanner::getName(uint64_t record)
+{
+    std::vector<char> buf;
+    if (!readRecord(record, buf))
+        return std::string();
+
+    const char *fn = findFileName(&buf[0], m_recordSize);
+    if (fn == NULL)
+        return std::string();
+
+    return utf16ToUtf8(fn + 66, (uint8_t)fn[64]);
+}
+
+/*
+ * Rebuild the parent directory path of a record in the same form
+ * TskAuto::processFile() receives it: empty for the root directory,
+ * otherwise "dir/sub/".
+ */
+std::string
+MftScanner::getPath(uint64_t record)
+{
+    std::string path;
+    uint64_t current = m_columns.parent[record];
+    for (int depth = 0; depth < NTFS_MAX_DEPTH; depth++)
+    {
+        if (current == NTFS_ROOT_RECORD || current >= m_recordCount ||
+                !(m_columns.flags[current] & MFT_RECORD_DIRECTORY))
+            break;
+
+        std::map<uint64_t, std::string>::iterator it =
+            m_dirNames.find(current);
+        if (it == m_dirNames.end())
+            it = m_dirNames.insert(
+                    std::make_pair(current, getName(current))).first;
+
+        path = it->second + "/" + path;
+        current = m_columns.parent[current];
+    }
+    return path;
+}
+
+static bool inWindow(int32_t t, int start, int end)
+{
+    return t > start && t < end;
+}
+
+/*
+ * Count a matching record in a collection's summary, with those of its
+ * $STANDARD_INFORMATION and $FILE_NAME times that fell in the window.
+ */
+void
+MftScanner::summarize(FileSummary *summary, uint64_t record, bool has_si,
+        bool has_fn, int cs, int ce, int ws, int we, pthread_mutex_t *lock,
+        const std::string &volume)
+{
+    const mft_columns &col = m_columns;
+    int32_t candidates[6] = {col.si_atime[record], col.si_mtime[record],
+        col.si_crtime[record], col.fn_atime[record], col.fn_mtime[record],
+        col.fn_crtime[record]};
+    time_t times[6];
+    size_t count = 0;
+    for (int t = 0; t < 6; t++)
+        if ((t < 3 ? has_si : has_fn) &&
+                (inWindow(candidates[t], cs, ce) ||
+                 inWindow(candidates[t], ws, we)))
+            times[count++] = candidates[t];
+
+    std::string path = getPath(record);
+    std::string name = getName(record);
+    if (lock)
+        pthread_mutex_lock(lock);
+    summary->add(volume, path.c_str(), name.c_str(), times, count);
+    if (lock)
+        pthread_mutex_unlock(lock);
+}
+
+void
+MftScanner::match(std::vector<AnomalyCollection*> *collections,
+        pthread_mutex_t *lock, const std::string &volume)
+{
+    TRACE_SCOPE("MftScanner::match");
+    ScopedPhase phase(PHASE_FILE_MATCH);
+
+    size_t count = collections->size();
+    std::vector<int> created_start(count), created_end(count);
+    std::vector<int> written_start(count), written_end(count);
+    for (size_t c = 0; c < count; c++)
+    {
+        AnomalyPair *pair = (*collections)[c]->getPair();
+        created_start[c] =
+            pair->getPreviousAnomaly()->getNextEvent()->getDateCreated();
+        created_end[c] =
+            pair->getNextAnomaly()->getPreviousEvent()->getDateCreated();
+        written_start[c] =
+            pair->getPreviousAnomaly()->getNextEvent()->getDateWritten();
+        written_end[c] =
+            pair->getNextAnomaly()->getPreviousEvent()->getDateWritten();
+    }
+
+    const mft_columns &col = m_columns;
+    for (uint64_t r = 0; r < m_recordCount; r++)
+    {
+        uint8_t flags = col.flags[r];
+        //deleted records keep their times until reused, as in the walk
+        if ((flags & (MFT_RECORD_DIRECTORY | MFT_RECORD_EXTENSION)) ||
+                !(flags & (MFT_RECORD_HAS_SI | MFT_RECORD_HAS_FN)))
+            continue;
+
+        bool has_si = flags & MFT_RECORD_HAS_SI;
+        bool has_fn = flags & MFT_RECORD_HAS_FN;
+        std::string path, name;
+        bool resolved = false;
+        bool queued = false;
+
+        for (size_t c = 0; c < count; c++)
+        {
+            int cs = created_start[c], ce = created_end[c];
+            int ws = written_start[c], we = written_end[c];
+            bool hit =
+                (has_si && (
+                    inWindow(col.si_atime[r], cs, ce) ||
+                    inWindow(col.si_atime[r], ws, we) ||
+                    inWindow(col.si_mtime[r], cs, ce) ||
+                    inWindow(col.si_mtime[r], ws, we) ||
+                    inWindow(col.si_crtime[r], cs, ce) ||
+                    inWindow(col.si_crtime[r], ws, we))) ||
+                (has_fn && (
+                    inWindow(col.fn_atime[r], cs, ce) ||
+                    inWindow(col.fn_atime[r], ws, we) ||
+                    inWindow(col.fn_mtime[r], cs, ce) ||
+                    inWindow(col.fn_mtime[r], ws, we) ||
+                    inWindow(col.fn_crtime[r], cs, ce) ||
+                    inWindow(col.fn_crtime[r], ws, we)));
+            if (!hit)
+                continue;
+
+            FileSummary *summary = (*collections)[c]->getSummary();
+            if (summary)
+            {
+                summarize(summary, r, has_si, has_fn, cs, ce, ws, we,
+                        lock, volume);
+                continue;
+            }
+
+            //names and paths are only resolved for matches
+            if (!resolved)
+            {
+                path = getPath(r);
+                name = getName(r);
+                resolved = true;
+            }
+
+            if (lock)
+                pthread_mutex_lock(lock);
+            (*collections)[c]->addFile(m_fs->offset, r, volume.c_str(),
+                    path.c_str(), name.c_str());
+            if (lock)
+                pthread_mutex_unlock(lock);
+
+            if (!queued)
+            {
+                FileHasher *hasher = (*collections)[c]->getHasher();
+                FileExporter *exporter = (*collections)[c]->getExporter();
+                if (hasher)
+                    hasher->add(m_fs->offset, r);
+                if (exporter)
+                    exporter->add(m_fs->offset, r, volume, path, name);
+                queued = true;
+            }
+        }
+    }
+}
+
+/*
+ * Add every intact record, in use or deleted, to the bodyfile, its
+ * $FILE_NAME times on a line of their own and deleted names marked as
+ * fls writes them. Paths are resolved for all of them, so this costs
+ * more than matching.
+ */
+void
+MftScanner::exportRecords(BodyfileWriter *bodyfile, const std::string &volume)
+{
+    TRACE_SCOPE("MftScanner::exportRecords");
+
+    const mft_columns &col = m_columns;
+    for (uint64_t r = 0; r < m_recordCount; r++)
+    {
+        uint8_t flags = col.flags[r];
+        if ((flags & MFT_RECORD_EXTENSION) ||
+                !(flags & (MFT_RECORD_HAS_SI | MFT_RECORD_HAS_FN)))
+            continue;
+
+        bool directory = flags & MFT_RECORD_DIRECTORY;
+        std::string path = getPath(r);
+        std::string name = getName(r);
+        if (!(flags & MFT_RECORD_IN_USE))
+            name += " (deleted)";
+        if (flags & MFT_RECORD_HAS_SI)
+            bodyfile->addRecord(volume, path, name, r, directory,
+                    col.si_atime[r], col.si_mtime[r], col.si_ctime[r],
+                    col.si_crtime[r]);
+        if (flags & MFT_RECORD_HAS_FN)
+            bodyfile->addRecord(volume, path, name + " ($FILE_NAME)", r,
+                    directory, col.fn_atime[r], col.fn_mtime[r],
+                    col.fn_ctime[r], col.fn_crtime[r]);
+    }
+}
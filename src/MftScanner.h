@@ -0,0 +1,98 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MFT_SCANNER_H
+#define MFT_SCANNER_H
+
+#include <tsk3/libtsk.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "Anomaly.h"
+#include "Bodyfile.h"
+#include "FileSummary.h"
+
+#define MFT_CHUNK_RECORDS       16384
+
+enum {
+    MFT_RECORD_IN_USE    = 0x01,
+    MFT_RECORD_DIRECTORY = 0x02,
+    MFT_RECORD_HAS_SI    = 0x04,
+    MFT_RECORD_HAS_FN    = 0x08,
+    MFT_RECORD_EXTENSION = 0x10
+};
+
+/*
+ * MAC times of every MFT record, one column per timestamp, indexed by
+ * record number. Times are UNIX seconds like LogEvent dates.
+ */
+struct mft_columns
+{
+    std::vector<uint8_t> flags;
+    std::vector<uint64_t> parent;
+    std::vector<int32_t> si_crtime;
+    std::vector<int32_t> si_mtime;
+    std::vector<int32_t> si_atime;
+    std::vector<int32_t> si_ctime;
+    std::vector<int32_t> fn_crtime;
+    std::vector<int32_t> fn_mtime;
+    std::vector<int32_t> fn_atime;
+    std::vector<int32_t> fn_ctime;
+};
+
+/*
+ * Fast path for NTFS MAC-time collection. Instead of walking the
+ * directory tree (random access into the MFT and a full metadata load
+ * per file), $MFT is read sequentially in large chunks while worker
+ * threads apply fixups and decode the $STANDARD_INFORMATION and
+ * $FILE_NAME times into columns. Paths are only rebuilt for records that
+ * fall into an anomaly window.
+ */
+class MftScanner
+{
+    private:
+        TSK_FS_INFO *m_fs;
+        TSK_FS_FILE *m_mft;
+        unsigned m_threads;
+        uint32_t m_recordSize;
+        uint64_t m_recordCount;
+        mft_columns m_columns;
+        std::map<uint64_t, std::string> m_dirNames;
+
+        bool readRecordSize();
+        bool readRecord(uint64_t record, std::vector<char> &buf);
+        std::string getName(uint64_t record);
+        std::string getPath(uint64_t record);
+        void summarize(FileSummary *summary, uint64_t record, bool has_si,
+                bool has_fn, int cs, int ce, int ws, int we,
+                pthread_mutex_t *lock, const std::string &volume);
+    public:
+        MftScanner(TSK_FS_INFO *fs, unsigned threads);
+        ~MftScanner();
+        bool scan();
+        void decodeRecords(char *buf, uint64_t first, size_t count);
+        void match(std::vector<AnomalyCollection*> *collections,
+                pthread_mutex_t *lock, const std::string &volume);
+        void exportRecords(BodyfileWriter *bodyfile,
+                const std::string &volume);
+        mft_columns& getColumns() { return m_columns; }
+        uint64_t getRecordCount() { return m_recordCount; }
+};
+
+#endif
@@ -18,12 +18,23 @@
 #ifndef OPTIONS_H
 #define OPTIONS_H
 
+#include <tsk3/libtsk.h>
+#include "Tadpole.h"
+
+/*
+ * Settings of the tadpole program itself; everything that shapes the
+ * analysis lives in tadpole_config.
+ */
 struct options
 {
-    int processFiles;
     int xml;
-};
+    TSK_TCHAR *statsFile;
+    TSK_TCHAR *traceFile;
+    TSK_TCHAR *daemonSocket;
+    tadpole_config config;
 
-struct options opt = {0, 0};
+    options() : xml(0), statsFile(NULL), traceFile(NULL),
+        daemonSocket(NULL) {}
+};
 
 #endif
@@ -0,0 +1,260 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ParallelWalker.h"
+#include <iostream>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include "FileProcessor.h"
+#include "Stats.h"
+#include "Trace.h"
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+ParallelWalker::ParallelWalker(FileProcessor *processor, TSK_FS_INFO *fs,
+        int count, const TSK_TCHAR * const *images, TSK_IMG_TYPE_ENUM type,
+        unsigned threads) :
+    m_processor(processor), m_fs(fs), m_count(count), m_images(images),
+    m_type(type), m_pending(0)
+{
+    if (threads == 0)
+        threads = 1;
+
+    for (unsigned i = 0; i < threads; i++)
+    {
+        walk_worker *worker = new walk_worker;
+        worker->walker = this;
+        worker->id = i;
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->img = NULL;
+        worker->fs = NULL;
+        worker->dirs = 0;
+        worker->files = 0;
+        worker->steals = 0;
+        worker->seconds = 0;
+        m_workers.push_back(worker);
+    }
+}
+
+ParallelWalker::~ParallelWalker()
+{
+    for (size_t i = 0; i < m_workers.size(); i++)
+    {
+        if (m_workers[i]->fs)
+            tsk_fs_close(m_workers[i]->fs);
+        if (m_workers[i]->img)
+            tsk_img_close(m_workers[i]->img);
+        pthread_mutex_destroy(&m_workers[i]->lock);
+        delete m_workers[i];
+    }
+}
+
+bool
+ParallelWalker::pop(walk_worker *worker, walk_dir &dir)
+{
+    pthread_mutex_lock(&worker->lock);
+    if (!worker->queue.empty())
+    {
+        dir = worker->queue.back();
+        worker->queue.pop_back();
+        pthread_mutex_unlock(&worker->lock);
+        return true;
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    //steal the oldest, and so usually largest, subtree of another worker
+    for (size_t i = 1; i < m_workers.size(); i++)
+    {
+        walk_worker *victim =
+            m_workers[(worker->id + i) % m_workers.size()];
+        pthread_mutex_lock(&victim->lock);
+        if (!victim->queue.empty())
+        {
+            dir = victim->queue.front();
+            victim->queue.pop_front();
+            pthread_mutex_unlock(&victim->lock);
+            worker->steals++;
+            return true;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+
+    return false;
+}
+
+void
+ParallelWalker::push(walk_worker *worker, const walk_dir &dir)
+{
+    __sync_fetch_and_add(&m_pending, 1);
+    pthread_mutex_lock(&worker->lock);
+    worker->queue.push_back(dir);
+    pthread_mutex_unlock(&worker->lock);
+}
+
+void
+ParallelWalker::processDir(walk_worker *worker, const walk_dir &dir)
+{
+    TSK_FS_DIR *fs_dir = tsk_fs_dir_open_meta(worker->fs, dir.inum);
+    if (fs_dir == NULL)
+    {
+        if (tsk_verbose)
+            std::cerr << "Unable to open directory " << dir.path
+                << std::endl;
+        tsk_error_reset();
+        return;
+    }
+    worker->dirs++;
+
+    size_t size = tsk_fs_dir_getsize(fs_dir);
+    for (size_t i = 0; i < size; i++)
+    {
+        TSK_FS_FILE *fs_file = tsk_fs_dir_get(fs_dir, i);
+        if (fs_file == NULL)
+        {
+            tsk_error_reset();
+            continue;
+        }
+
+        //unallocated names are matched like the TskAuto walk does
+        TSK_FS_NAME *name = fs_file->name;
+        if (strcmp(name->name, ".") == 0 ||
+                strcmp(name->name, "..") == 0)
+        {
+            tsk_fs_file_close(fs_file);
+            continue;
+        }
+
+        m_processor->exportFile(fs_file, dir.path.c_str());
+        if (name->type == TSK_FS_NAME_TYPE_DIR ||
+                (fs_file->meta && fs_file->meta->type == TSK_FS_META_TYPE_DIR))
+        {
+            //deleted names may point at reused entries, so only allocated
+            //directories are entered; the visited map keeps corrupt trees
+            //from looping
+            TSK_INUM_T inum = name->meta_addr;
+            if ((name->flags & TSK_FS_NAME_FLAG_ALLOC) &&
+                    inum < m_visited.size() &&
+                    __sync_lock_test_and_set(&m_visited[inum], 1) == 0)
+            {
+                walk_dir sub;
+                sub.inum = inum;
+                sub.path = dir.path + name->name + "/";
+                push(worker, sub);
+            }
+        }
+        else
+        {
+            worker->files++;
+            Stats::addFile();
+            m_processor->matchFile(fs_file, dir.path.c_str());
+        }
+
+        tsk_fs_file_close(fs_file);
+    }
+
+    tsk_fs_dir_close(fs_dir);
+}
+
+void*
+ParallelWalker::run(void *arg)
+{
+    walk_worker *worker = (walk_worker*)arg;
+    ParallelWalker *self = worker->walker;
+    TRACE_SCOPE_INDEX("ParallelWalker::worker", worker->id);
+    ScopedPhase phase(PHASE_FS_WALK);
+
+    double start = now();
+    walk_dir dir;
+    for (;;)
+    {
+        if (self->pop(worker, dir))
+        {
+            self->processDir(worker, dir);
+            //subdirectories were counted before this one is released
+            __sync_fetch_and_sub(&self->m_pending, 1);
+        }
+        else if (__sync_fetch_and_add(&self->m_pending, 0) == 0)
+            break;
+        else
+            sched_yield();
+    }
+    worker->seconds = now() - start;
+
+    return NULL;
+}
+
+bool
+ParallelWalker::walk()
+{
+    TRACE_SCOPE("ParallelWalker::walk");
+
+    for (size_t i = 0; i < m_workers.size(); i++)
+    {
+        walk_worker *worker = m_workers[i];
+        worker->img = tsk_img_open(m_count, m_images, m_type, 0);
+        if (worker->img)
+            worker->fs = tsk_fs_open_img(worker->img, m_fs->offset,
+                    m_fs->ftype);
+        if (worker->fs == NULL)
+        {
+            tsk_error_reset();
+            return false;
+        }
+    }
+
+    m_visited.assign(m_fs->last_inum + 1, 0);
+    walk_dir root;
+    root.inum = m_fs->root_inum;
+    root.path = "";
+    if (root.inum < m_visited.size())
+        m_visited[root.inum] = 1;
+    push(m_workers[0], root);
+
+    std::vector<pthread_t> threads(m_workers.size());
+    std::vector<bool> started(m_workers.size(), false);
+    for (size_t i = 1; i < m_workers.size(); i++)
+        started[i] = (pthread_create(&threads[i], NULL, run,
+                    m_workers[i]) == 0);
+    run(m_workers[0]);
+    for (size_t i = 1; i < m_workers.size(); i++)
+        if (started[i])
+            pthread_join(threads[i], NULL);
+
+    if (tsk_verbose || Stats::enabled())
+    {
+        for (size_t i = 0; i < m_workers.size(); i++)
+        {
+            walk_worker *worker = m_workers[i];
+            double rate = worker->seconds > 0 ?
+                worker->files / worker->seconds : 0;
+            std::cerr << "Walker " << worker->id << ": "
+                << worker->dirs << " dirs, "
+                << worker->files << " files, "
+                << worker->steals << " steals in "
+                << worker->seconds << "s ("
+                << (uint64_t)rate << " files/s)" << std::endl;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,83 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARALLEL_WALKER_H
+#define PARALLEL_WALKER_H
+
+#include <tsk3/libtsk.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+class FileProcessor;
+
+struct walk_dir
+{
+    TSK_INUM_T inum;
+    std::string path;
+};
+
+class ParallelWalker;
+
+struct walk_worker
+{
+    ParallelWalker *walker;
+    unsigned id;
+    pthread_mutex_t lock;
+    std::deque<walk_dir> queue;
+    TSK_IMG_INFO *img;
+    TSK_FS_INFO *fs;
+    uint64_t dirs;
+    uint64_t files;
+    uint64_t steals;
+    double seconds;
+};
+
+/*
+ * Work-stealing directory walker for file systems without a bulk
+ * metadata path. Each worker owns an image and file system handle and a
+ * deque of directories; it takes work from the back of its own deque and
+ * steals from the front of the others when it runs dry, so deep subtrees
+ * spread over all workers. Useful where walks are bound by seek latency.
+ */
+class ParallelWalker
+{
+    private:
+        FileProcessor *m_processor;
+        TSK_FS_INFO *m_fs;
+        int m_count;
+        const TSK_TCHAR * const *m_images;
+        TSK_IMG_TYPE_ENUM m_type;
+        std::vector<walk_worker*> m_workers;
+        std::vector<uint8_t> m_visited;
+        long m_pending;
+
+        bool pop(walk_worker *worker, walk_dir &dir);
+        void push(walk_worker *worker, const walk_dir &dir);
+        void processDir(walk_worker *worker, const walk_dir &dir);
+        static void* run(void *arg);
+    public:
+        ParallelWalker(FileProcessor *processor, TSK_FS_INFO *fs,
+                int count, const TSK_TCHAR * const *images,
+                TSK_IMG_TYPE_ENUM type, unsigned threads);
+        ~ParallelWalker();
+        bool walk();
+};
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ParserRegistry.h"
+#include <string.h>
+
+static inline char lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+ParserRegistry::ParserRegistry()
+{
+    memset(m_slots, 0, sizeof(m_slots));
+}
+
+ParserRegistry::~ParserRegistry()
+{
+    for (size_t i = 0; i < m_parsers.size(); i++)
+        delete m_parsers[i];
+}
+
+//FNV-1a over the lowercased extension
+uint32_t
+ParserRegistry::hashExtension(const char *extension, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)lower(extension[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void
+ParserRegistry::add(ILogParser *parser)
+{
+    m_parsers.push_back(parser);
+
+    std::string extension = parser->getExtension();
+    if (extension.empty() || extension.length() > MAX_EXTENSION ||
+            m_parsers.size() >= REGISTRY_SLOTS)
+        return;
+
+    uint32_t slot = hashExtension(extension.c_str(), extension.length())
+        & (REGISTRY_SLOTS - 1);
+    while (m_slots[slot].parser != NULL)
+        slot = (slot + 1) & (REGISTRY_SLOTS - 1);
+
+    for (size_t i = 0; i < extension.length(); i++)
+        m_slots[slot].extension[i] = lower(extension[i]);
+    m_slots[slot].extension[extension.length()] = '\0';
+    m_slots[slot].length = extension.length();
+    m_slots[slot].parser = parser;
+}
+
+void
+ParserRegistry::setTimeWindow(time_t since, time_t until)
+{
+    for (size_t i = 0; i < m_parsers.size(); i++)
+        m_parsers[i]->setTimeWindow(since, until);
+}
+
+/*
+ * Match the text after the last dot of the name, case-insensitively.
+ * Names without an extension, or that are only an extension, never match.
+ */
+ILogParser*
+ParserRegistry::byExtension(const char *name) const
+{
+    const char *dot = strrchr(name, '.');
+    if (dot == NULL || dot == name)
+        return NULL;
+
+    const char *extension = dot + 1;
+    size_t length = strlen(extension);
+    if (length == 0 || length > MAX_EXTENSION)
+        return NULL;
+
+    uint32_t slot = hashExtension(extension, length) & (REGISTRY_SLOTS - 1);
+    while (m_slots[slot].parser != NULL)
+    {
+        if (m_slots[slot].length == length)
+        {
+            size_t i = 0;
+            while (i < length &&
+                    lower(extension[i]) == m_slots[slot].extension[i])
+                i++;
+            if (i == length)
+                return m_slots[slot].parser;
+        }
+        slot = (slot + 1) & (REGISTRY_SLOTS - 1);
+    }
+
+    return NULL;
+}
+
+ILogParser*
+ParserRegistry::bySignature(const char *header, size_t length) const
+{
+    for (size_t i = 0; i < m_parsers.size(); i++)
+        if (m_parsers[i]->matchesSignature(header, length))
+            return m_parsers[i];
+    return NULL;
+}
@@ -0,0 +1,58 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARSER_REGISTRY_H
+#define PARSER_REGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "ILogParser.h"
+
+#define REGISTRY_SLOTS  64
+#define MAX_EXTENSION   15
+
+struct registry_slot
+{
+    char extension[MAX_EXTENSION + 1];
+    size_t length;
+    ILogParser *parser;
+};
+
+/*
+ * Owns the log parsers and picks one for a file. Extensions are kept
+ * lowercased in a small open-addressed hash table so a lookup hashes the
+ * name's extension in place, without copying or allocating. Signature
+ * lookups try each parser's header check in registration order.
+ */
+class ParserRegistry
+{
+    private:
+        std::vector<ILogParser*> m_parsers;
+        registry_slot m_slots[REGISTRY_SLOTS];
+
+        static uint32_t hashExtension(const char *extension, size_t length);
+    public:
+        ParserRegistry();
+        ~ParserRegistry();
+        void add(ILogParser *parser);
+        void setTimeWindow(time_t since, time_t until);
+        ILogParser* byExtension(const char *name) const;
+        ILogParser* bySignature(const char *header, size_t length) const;
+};
+
+#endif
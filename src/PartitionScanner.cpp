@@ -0,0 +1,260 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PartitionScanner.h"
+#include <pthread.h>
+#include <iostream>
+#include <sstream>
+#include "FileProcessor.h"
+#include "Trace.h"
+#include "exceptions/Exception.h"
+
+struct partition_job
+{
+    const TSK_TCHAR * const *images;
+    int count;
+    TSK_IMG_TYPE_ENUM type;
+    partition_info partition;
+    bool prefetch;
+    bool mftScan;
+    bool parallelWalk;
+    unsigned threads;
+    LogProcessor *lp;
+    std::vector<AnomalyCollection*> *collections;
+    pthread_mutex_t *lock;
+    const Deadline *deadline;
+    BodyfileWriter *bodyfile;
+    uint64_t filesScanned;
+    bool complete;
+    bool failed;
+};
+
+/*
+ * Enumerate the allocated partitions of the volume system. Returns false
+ * when the image has no volume system (a bare file system), in which case
+ * there is nothing to parallelize.
+ */
+bool
+PartitionScanner::findPartitions()
+{
+    m_partitions.clear();
+
+    TSK_IMG_INFO *img = tsk_img_open(m_count, m_images, m_type, 0);
+    if (img == NULL)
+        return false;
+
+    TSK_VS_INFO *vs = tsk_vs_open(img, 0, TSK_VS_TYPE_DETECT);
+    if (vs == NULL)
+    {
+        tsk_error_reset();
+        tsk_img_close(img);
+        return false;
+    }
+
+    for (TSK_PNUM_T i = 0; i < vs->part_count; i++)
+    {
+        const TSK_VS_PART_INFO *part = tsk_vs_part_get(vs, i);
+        if (part == NULL || !(part->flags & TSK_VS_PART_FLAG_ALLOC))
+            continue;
+
+        std::ostringstream label;
+        label << "vol" << part->addr;
+        if (part->desc)
+            label << " (" << part->desc << ")";
+
+        partition_info info;
+        info.offset = vs->offset + (TSK_OFF_T)part->start * vs->block_size;
+        info.label = label.str();
+        m_partitions.push_back(info);
+    }
+
+    tsk_vs_close(vs);
+    tsk_img_close(img);
+
+    return m_partitions.size() > 0;
+}
+
+static void*
+processPartitionLogs(void *arg)
+{
+    partition_job *job = (partition_job*)arg;
+    TRACE_SCOPE_FILE("PartitionScanner::logs", "",
+            job->partition.label.c_str());
+
+    if (job->lp->openImage(job->count, job->images, job->type, 0))
+    {
+        job->failed = true;
+        return NULL;
+    }
+    if (job->prefetch)
+        job->lp->enablePrefetch(job->images[0]);
+
+    job->lp->setVolume(job->partition.offset, job->partition.label);
+    //a parser error must not escape the thread
+    try
+    {
+        job->failed = job->lp->findLogs();
+        //logs held back for a deadline are ordered within the volume
+        if (!job->failed)
+            job->lp->processDeferredLogs();
+    }
+    catch (Exception &e)
+    {
+        job->failed = true;
+    }
+
+    return NULL;
+}
+
+static void*
+processPartitionFiles(void *arg)
+{
+    partition_job *job = (partition_job*)arg;
+    TRACE_SCOPE_FILE("PartitionScanner::files", "",
+            job->partition.label.c_str());
+
+    FileProcessor fp(job->collections, job->lock);
+    if (fp.openImage(job->count, job->images, job->type, 0))
+    {
+        job->failed = true;
+        return NULL;
+    }
+
+    fp.setVolume(job->partition.offset, job->partition.label);
+    fp.setMftScan(job->mftScan, job->threads);
+    if (job->parallelWalk)
+        fp.setParallelWalk(job->count, job->images, job->type);
+    fp.setDeadline(job->deadline);
+    fp.setBodyfile(job->bodyfile);
+    job->failed = fp.findAndProcessFiles();
+    job->filesScanned = fp.getFilesScanned();
+    job->complete = fp.isComplete();
+
+    return NULL;
+}
+
+static bool
+runJobs(std::vector<partition_job> &jobs, void *(*worker)(void*))
+{
+    std::vector<pthread_t> threads(jobs.size());
+    std::vector<bool> started(jobs.size(), false);
+    for (size_t i = 0; i < jobs.size(); i++)
+        started[i] = (pthread_create(&threads[i], NULL, worker,
+                    &jobs[i]) == 0);
+
+    TRACE_SCOPE("PartitionScanner::join");
+    bool failed = false;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            jobs[i].failed = true;
+
+        if (jobs[i].failed)
+        {
+            std::cerr << "Error scanning " << jobs[i].partition.label
+                << std::endl;
+            tsk_error_print(stderr);
+            failed = true;
+        }
+    }
+
+    return failed;
+}
+
+bool
+PartitionScanner::processLogs(LogProcessor *merged)
+{
+    std::vector<partition_job> jobs(m_partitions.size());
+    for (size_t i = 0; i < m_partitions.size(); i++)
+    {
+        jobs[i].images = m_images;
+        jobs[i].count = m_count;
+        jobs[i].type = m_type;
+        jobs[i].partition = m_partitions[i];
+        jobs[i].prefetch = m_prefetch;
+        jobs[i].mftScan = false;
+        jobs[i].parallelWalk = false;
+        jobs[i].threads = 1;
+        jobs[i].lp = new LogProcessor();
+        jobs[i].lp->configureLike(*merged);
+        jobs[i].collections = NULL;
+        jobs[i].lock = NULL;
+        jobs[i].deadline = NULL;
+        jobs[i].bodyfile = NULL;
+        jobs[i].filesScanned = 0;
+        jobs[i].complete = true;
+        jobs[i].failed = false;
+    }
+
+    bool failed = runJobs(jobs, processPartitionLogs);
+
+    //merge in partition order so the report is deterministic
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        merged->addLoggedAnomalies(jobs[i].lp->getLoggedAnomalies());
+        merged->takeTimeline(jobs[i].lp);
+        merged->addFindings(jobs[i].lp->getFindings());
+        merged->takeSweep(jobs[i].lp);
+        merged->addCoverage(jobs[i].lp->getCoverage());
+        delete jobs[i].lp;
+    }
+    merged->buildCollections();
+
+    return failed;
+}
+
+bool
+PartitionScanner::processFiles(std::vector<AnomalyCollection*> *collections)
+{
+    pthread_mutex_t lock;
+    pthread_mutex_init(&lock, NULL);
+
+    std::vector<partition_job> jobs(m_partitions.size());
+    for (size_t i = 0; i < m_partitions.size(); i++)
+    {
+        jobs[i].images = m_images;
+        jobs[i].count = m_count;
+        jobs[i].type = m_type;
+        jobs[i].partition = m_partitions[i];
+        jobs[i].prefetch = false;
+        jobs[i].mftScan = m_mftScan;
+        jobs[i].parallelWalk = m_parallelWalk;
+        jobs[i].threads = m_threads;
+        jobs[i].lp = NULL;
+        jobs[i].collections = collections;
+        jobs[i].lock = &lock;
+        jobs[i].deadline = m_deadline;
+        jobs[i].bodyfile = m_bodyfile;
+        jobs[i].filesScanned = 0;
+        jobs[i].complete = true;
+        jobs[i].failed = false;
+    }
+
+    bool failed = runJobs(jobs, processPartitionFiles);
+
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        m_coverage.filesScanned += jobs[i].filesScanned;
+        m_coverage.filesComplete = m_coverage.filesComplete &&
+            jobs[i].complete;
+    }
+    pthread_mutex_destroy(&lock);
+
+    return failed;
+}
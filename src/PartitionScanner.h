@@ -0,0 +1,73 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARTITION_SCANNER_H
+#define PARTITION_SCANNER_H
+
+#include <tsk3/libtsk.h>
+#include <string>
+#include <vector>
+#include "LogProcessor.h"
+
+struct partition_info
+{
+    TSK_OFF_T offset;
+    std::string label;
+};
+
+/*
+ * Scans every allocated partition of a volume system on its own thread,
+ * each with its own image handle, so volumes on separate spindles are
+ * read concurrently. Log results are merged into one LogProcessor so the
+ * collections span all volumes; every log and file is tagged with the
+ * volume it came from.
+ */
+class PartitionScanner
+{
+    private:
+        int m_count;
+        const TSK_TCHAR * const *m_images;
+        TSK_IMG_TYPE_ENUM m_type;
+        bool m_prefetch;
+        bool m_mftScan;
+        bool m_parallelWalk;
+        unsigned m_threads;
+        const Deadline *m_deadline;
+        BodyfileWriter *m_bodyfile;
+        scan_coverage m_coverage;
+        std::vector<partition_info> m_partitions;
+    public:
+        PartitionScanner(int count, const TSK_TCHAR * const *images,
+                TSK_IMG_TYPE_ENUM type) :
+            m_count(count), m_images(images), m_type(type),
+            m_prefetch(false), m_mftScan(false), m_parallelWalk(false),
+            m_threads(1), m_deadline(NULL), m_bodyfile(NULL) {};
+        void setPrefetch(bool prefetch) { m_prefetch = prefetch; }
+        void setMftScan(bool enabled, unsigned threads)
+            { m_mftScan = enabled; m_threads = threads; }
+        void setParallelWalk(bool enabled) { m_parallelWalk = enabled; }
+        void setDeadline(const Deadline *deadline) { m_deadline = deadline; }
+        void setBodyfile(BodyfileWriter *bodyfile) { m_bodyfile = bodyfile; }
+        bool findPartitions();
+        std::vector<partition_info> getPartitions() { return m_partitions; }
+        bool processLogs(LogProcessor *merged);
+        bool processFiles(std::vector<AnomalyCollection*> *collections);
+        //how far the file scan got
+        scan_coverage getCoverage() { return m_coverage; }
+};
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PathPool.h"
+
+//a string's own size and its node in the index, besides its characters
+#define POOL_ENTRY_BYTES \
+    (sizeof(std::string) + 4 * sizeof(void*) + sizeof(string_id))
+
+PathPool::PathPool() : m_bytes(0)
+{
+    pthread_mutex_init(&m_lock, NULL);
+}
+
+PathPool::~PathPool()
+{
+    pthread_mutex_destroy(&m_lock);
+}
+
+string_id
+PathPool::intern(const char *s)
+{
+    pthread_mutex_lock(&m_lock);
+    std::map<const char*, string_id, cstring_less>::iterator it =
+        m_index.find(s);
+    string_id id;
+    if (it != m_index.end())
+        id = it->second;
+    else
+    {
+        id = m_strings.size();
+        m_strings.push_back(s);
+        m_index[m_strings.back().c_str()] = id;
+        m_bytes += POOL_ENTRY_BYTES + m_strings.back().size() + 1;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return id;
+}
+
+const std::string&
+PathPool::get(string_id id)
+{
+    //the deque's block map may be growing on another thread
+    pthread_mutex_lock(&m_lock);
+    const std::string &s = m_strings[id];
+    pthread_mutex_unlock(&m_lock);
+    return s;
+}
+
+size_t
+PathPool::getBytes()
+{
+    pthread_mutex_lock(&m_lock);
+    size_t bytes = m_bytes;
+    pthread_mutex_unlock(&m_lock);
+    return bytes;
+}
+
+void
+PathPool::clear()
+{
+    pthread_mutex_lock(&m_lock);
+    m_index.clear();
+    std::deque<std::string>().swap(m_strings);
+    m_bytes = 0;
+    pthread_mutex_unlock(&m_lock);
+}
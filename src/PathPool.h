@@ -0,0 +1,65 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PATH_POOL_H
+#define PATH_POOL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <deque>
+#include <map>
+#include <string>
+
+typedef uint32_t string_id;
+
+struct cstring_less
+{
+    bool operator()(const char *a, const char *b) const
+        { return strcmp(a, b) < 0; }
+};
+
+/*
+ * Interned directory paths, file names and volume labels: each distinct
+ * string is stored once and referred to by its index, and only turned
+ * back into a string for output. Looking up a string already in the pool
+ * does not allocate. getBytes() is what the pool holds, for a memory
+ * budget; clear() frees it all and invalidates every id handed out.
+ * Safe to use from several threads.
+ */
+class PathPool
+{
+    private:
+        //a deque never moves its elements, so the index can point into them
+        std::deque<std::string> m_strings;
+        std::map<const char*, string_id, cstring_less> m_index;
+        size_t m_bytes;
+        pthread_mutex_t m_lock;
+
+        PathPool(const PathPool&);
+        PathPool& operator=(const PathPool&);
+    public:
+        PathPool();
+        ~PathPool();
+        string_id intern(const char *s);
+        string_id intern(const std::string &s) { return intern(s.c_str()); }
+        const std::string& get(string_id id);
+        size_t getBytes();
+        void clear();
+};
+
+#endif
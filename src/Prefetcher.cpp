@@ -0,0 +1,276 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Prefetcher.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+Prefetcher::Prefetcher() :
+    m_fd(-1), m_started(false), m_stop(false), m_bytes(0)
+{
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_cond, NULL);
+#ifdef HAVE_LIBURING
+    m_uring = false;
+#endif
+}
+
+Prefetcher::~Prefetcher()
+{
+    if (m_started)
+    {
+        pthread_mutex_lock(&m_lock);
+        m_stop = true;
+        m_queue.clear();
+        pthread_cond_signal(&m_cond);
+        pthread_mutex_unlock(&m_lock);
+        pthread_join(m_thread, NULL);
+
+        if (tsk_verbose)
+            fprintf(stderr, "Prefetcher: %llu bytes read ahead\n",
+                    (unsigned long long)m_bytes);
+    }
+
+#ifdef HAVE_LIBURING
+    if (m_uring)
+        io_uring_queue_exit(&m_ring);
+#endif
+
+    for (size_t i = 0; i < m_buffers.size(); i++)
+        free(m_buffers[i]);
+
+    if (m_fd >= 0)
+        close(m_fd);
+
+    pthread_cond_destroy(&m_cond);
+    pthread_mutex_destroy(&m_lock);
+}
+
+bool
+Prefetcher::open(const TSK_TCHAR *image)
+{
+    m_fd = ::open(image, O_RDONLY);
+    if (m_fd < 0)
+        return false;
+
+#ifdef HAVE_LIBURING
+    m_uring = (io_uring_queue_init(PREFETCH_DEPTH, &m_ring, 0) == 0);
+    if (!m_uring && tsk_verbose)
+        fprintf(stderr, "Prefetcher: io_uring unavailable, "
+                "using blocking reads\n");
+    m_buffers.resize(m_uring ? PREFETCH_DEPTH : 1);
+#else
+    m_buffers.resize(1);
+#endif
+    for (size_t i = 0; i < m_buffers.size(); i++)
+        m_buffers[i] = (char*)malloc(PREFETCH_REQUEST_SIZE);
+
+    if (pthread_create(&m_thread, NULL, run, this) != 0)
+        return false;
+    m_started = true;
+
+    return true;
+}
+
+void
+Prefetcher::prefetchFile(TSK_FS_FILE *fs_file)
+{
+    if (!m_started || fs_file->fs_info == NULL)
+        return;
+
+    const TSK_FS_ATTR *attr = tsk_fs_file_attr_get(fs_file);
+    if (attr == NULL)
+    {
+        tsk_error_reset();
+        return;
+    }
+
+    //resident data was read along with the metadata
+    if (!(attr->flags & TSK_FS_ATTR_NONRES))
+        return;
+
+    TSK_FS_INFO *fs = fs_file->fs_info;
+    pthread_mutex_lock(&m_lock);
+    for (TSK_FS_ATTR_RUN *run = attr->nrd.run; run; run = run->next)
+    {
+        if (run->flags & 
+                (TSK_FS_ATTR_RUN_FLAG_SPARSE | TSK_FS_ATTR_RUN_FLAG_FILLER))
+            continue;
+
+        prefetch_range range;
+        range.offset = fs->offset + (TSK_OFF_T)run->addr * fs->block_size;
+        range.length = (TSK_OFF_T)run->len * fs->block_size;
+        m_queue.push_back(range);
+    }
+    pthread_cond_signal(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+}
+
+void*
+Prefetcher::run(void *arg)
+{
+    Prefetcher *self = (Prefetcher*)arg;
+
+    pthread_mutex_lock(&self->m_lock);
+    while (!self->m_stop)
+    {
+        if (self->m_queue.empty())
+        {
+            pthread_cond_wait(&self->m_cond, &self->m_lock);
+            continue;
+        }
+
+        std::vector<prefetch_range> ranges(self->m_queue.begin(),
+                self->m_queue.end());
+        self->m_queue.clear();
+        pthread_mutex_unlock(&self->m_lock);
+
+#ifdef HAVE_LIBURING
+        if (self->m_uring)
+            self->readUring(ranges);
+        else
+#endif
+            self->readBlocking(ranges);
+
+        pthread_mutex_lock(&self->m_lock);
+    }
+    pthread_mutex_unlock(&self->m_lock);
+
+    return NULL;
+}
+
+void
+Prefetcher::readBlocking(std::vector<prefetch_range> &ranges)
+{
+    for (size_t r = 0; r < ranges.size(); r++)
+    {
+        TSK_OFF_T offset = ranges[r].offset;
+        TSK_OFF_T end = offset + ranges[r].length;
+        while (offset < end)
+        {
+            size_t len = PREFETCH_REQUEST_SIZE;
+            if (end - offset < (TSK_OFF_T)len)
+                len = end - offset;
+            ssize_t read = pread(m_fd, m_buffers[0], len, offset);
+            if (read <= 0)
+                break;
+            m_bytes += read;
+            offset += read;
+        }
+    }
+}
+
+#ifdef HAVE_LIBURING
+void
+Prefetcher::readUring(std::vector<prefetch_range> &ranges)
+{
+    std::vector<size_t> free_buffers;
+    for (size_t i = 0; i < m_buffers.size(); i++)
+        free_buffers.push_back(i);
+
+    size_t r = 0;
+    TSK_OFF_T offset = ranges.empty() ? 0 : ranges[0].offset;
+    unsigned inflight = 0;
+
+    for (;;)
+    {
+        //fill the submission queue up to the available buffers
+        unsigned queued = 0;
+        while (r < ranges.size() && !free_buffers.empty())
+        {
+            TSK_OFF_T end = ranges[r].offset + ranges[r].length;
+            if (offset >= end)
+            {
+                if (++r < ranges.size())
+                    offset = ranges[r].offset;
+                continue;
+            }
+
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&m_ring);
+            if (sqe == NULL)
+                break;
+
+            size_t len = PREFETCH_REQUEST_SIZE;
+            if (end - offset < (TSK_OFF_T)len)
+                len = end - offset;
+
+            size_t buffer = free_buffers.back();
+            free_buffers.pop_back();
+            io_uring_prep_read(sqe, m_fd, m_buffers[buffer], len, offset);
+            io_uring_sqe_set_data(sqe, (void*)buffer);
+            offset += len;
+            queued++;
+        }
+
+        if (queued > 0)
+        {
+            inflight += queued;
+            if (io_uring_submit(&m_ring) < 0)
+            {
+                abandonRing(free_buffers);
+                return;
+            }
+        }
+
+        if (inflight == 0)
+            break;
+
+        //reap at least one completion, then whatever else is ready; a
+        //signal only interrupts the wait, the reads are still in flight
+        struct io_uring_cqe *cqe;
+        int ret = io_uring_wait_cqe(&m_ring, &cqe);
+        if (ret == -EINTR)
+            continue;
+        if (ret < 0)
+        {
+            abandonRing(free_buffers);
+            return;
+        }
+        do
+        {
+            if (cqe->res > 0)
+                m_bytes += cqe->res;
+            free_buffers.push_back((size_t)io_uring_cqe_get_data(cqe));
+            io_uring_cqe_seen(&m_ring, cqe);
+            inflight--;
+        }
+        while (inflight > 0 && io_uring_peek_cqe(&m_ring, &cqe) == 0);
+    }
+}
+
+void
+Prefetcher::abandonRing(const std::vector<size_t> &free_buffers)
+{
+    //the kernel may still complete reads into the buffers in flight, so
+    //those and the ring are leaked rather than freed; later ranges use
+    //blocking reads with a buffer that is known to be idle
+    std::vector<char*> idle;
+    for (size_t i = 0; i < free_buffers.size(); i++)
+        idle.push_back(m_buffers[free_buffers[i]]);
+    if (idle.empty())
+        idle.push_back((char*)malloc(PREFETCH_REQUEST_SIZE));
+    m_buffers.swap(idle);
+    m_uring = false;
+
+    if (tsk_verbose)
+        fprintf(stderr, "Prefetcher: io_uring failed, "
+                "using blocking reads\n");
+}
+#endif
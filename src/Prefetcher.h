@@ -0,0 +1,75 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <config.h>
+#include <tsk3/libtsk.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#define PREFETCH_DEPTH          32
+#define PREFETCH_REQUEST_SIZE   (256 * 1024)
+
+struct prefetch_range
+{
+    TSK_OFF_T offset;
+    TSK_OFF_T length;
+};
+
+/*
+ * Warms the page cache for a log's data runs on a raw image while the
+ * parser is still busy. Ranges are resolved from the file's non-resident
+ * attribute and read on a background thread, with up to PREFETCH_DEPTH
+ * requests in flight through io_uring. Without io_uring the thread falls
+ * back to blocking pread() calls, which still overlap with parsing.
+ */
+class Prefetcher
+{
+    private:
+        int m_fd;
+        bool m_started;
+        bool m_stop;
+        pthread_t m_thread;
+        pthread_mutex_t m_lock;
+        pthread_cond_t m_cond;
+        std::deque<prefetch_range> m_queue;
+        std::vector<char*> m_buffers;
+        uint64_t m_bytes;
+#ifdef HAVE_LIBURING
+        bool m_uring;
+        struct io_uring m_ring;
+        void readUring(std::vector<prefetch_range> &ranges);
+        void abandonRing(const std::vector<size_t> &free_buffers);
+#endif
+        void readBlocking(std::vector<prefetch_range> &ranges);
+        static void* run(void *arg);
+    public:
+        Prefetcher();
+        ~Prefetcher();
+        bool open(const TSK_TCHAR *image);
+        void prefetchFile(TSK_FS_FILE *fs_file);
+};
+
+#endif
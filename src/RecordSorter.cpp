@@ -0,0 +1,95 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RecordSorter.h"
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include "Stats.h"
+
+/*
+ * Each entry packs a key, made relative to the smallest record number,
+ * above the event's position, so a pass moves one word per event and
+ * only as many digits are sorted as the span of record numbers needs.
+ */
+void
+RecordSorter::sort(std::vector<LogEvent*> &events)
+{
+    ScopedPhase phase(PHASE_DETECT);
+    size_t n = events.size();
+    if (n < 2 || (uint64_t)n > 0xffffffffu)
+        return;
+
+    uint32_t low = 0xffffffffu;
+    uint32_t high = 0;
+    bool sorted = true;
+    m_keys.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t key = (uint32_t)events[i]->getEventId();
+        if (i > 0 && key < (uint32_t)(m_keys[i - 1] >> 32))
+            sorted = false;
+        m_keys[i] = ((uint64_t)key << 32) | i;
+        low = std::min(low, key);
+        high = std::max(high, key);
+    }
+    if (sorted)
+        return;
+
+    //the fewest passes that cover the span, each on an even share of it
+    int bits = 0;
+    while (bits < 32 && ((high - low) >> bits) != 0)
+        bits++;
+    int passes = (bits + RADIX_MAX_BITS - 1) / RADIX_MAX_BITS;
+    int digit = (bits + passes - 1) / passes;
+    uint32_t buckets = 1u << digit;
+    uint32_t mask = buckets - 1;
+
+    m_keysOut.resize(n);
+    m_counts.resize(buckets);
+    uint64_t *keys = &m_keys[0];
+    uint64_t *keysOut = &m_keysOut[0];
+    uint32_t *count = &m_counts[0];
+    uint64_t base = (uint64_t)low << 32;
+    for (int p = 0; p < passes; p++)
+    {
+        int shift = 32 + p * digit;
+        memset(count, 0, buckets * sizeof(uint32_t));
+        for (size_t i = 0; i < n; i++)
+            count[((keys[i] - base) >> shift) & mask]++;
+
+        uint32_t offset = 0;
+        for (uint32_t d = 0; d < buckets; d++)
+        {
+            uint32_t c = count[d];
+            count[d] = offset;
+            offset += c;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t entry = keys[i];
+            keysOut[count[((entry - base) >> shift) & mask]++] = entry;
+        }
+        std::swap(keys, keysOut);
+    }
+
+    m_eventsOut.resize(n);
+    for (size_t i = 0; i < n; i++)
+        m_eventsOut[i] = events[(uint32_t)keys[i]];
+    events.swap(m_eventsOut);
+}
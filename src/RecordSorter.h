@@ -0,0 +1,46 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RECORD_SORTER_H
+#define RECORD_SORTER_H
+
+#include <stdint.h>
+#include <vector>
+#include "ILogParser.h"
+
+//widest digit a pass sorts on
+#define RADIX_MAX_BITS  16
+
+/*
+ * Puts a log's events back in record-number order before detection, for
+ * wrapped EVT buffers and recovered EVTX chunks that hand records over
+ * out of sequence. The record numbers are pulled into their own key
+ * array and sorted with an LSD radix sort; a log already in order costs
+ * a single scan. The buffers are kept between logs.
+ */
+class RecordSorter
+{
+    private:
+        std::vector<uint64_t> m_keys;
+        std::vector<uint64_t> m_keysOut;
+        std::vector<LogEvent*> m_eventsOut;
+        std::vector<uint32_t> m_counts;
+    public:
+        void sort(std::vector<LogEvent*> &events);
+};
+
+#endif
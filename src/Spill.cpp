@@ -0,0 +1,233 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Spill.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include "FileHasher.h"
+
+FILE*
+MemoryBudget::createRun()
+{
+    const char *dir = getenv("TMPDIR");
+    std::string path = std::string(dir && *dir ? dir : "/tmp") +
+        "/tadpole-XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back(0);
+
+    int fd = mkstemp(&name[0]);
+    if (fd < 0)
+        return NULL;
+    unlink(&name[0]);
+
+    FILE *run = fdopen(fd, "w+b");
+    if (run == NULL)
+        close(fd);
+    return run;
+}
+
+bool
+file_order::operator()(const file_ref &a, const file_ref &b) const
+{
+    //equal ids are equal strings, so most comparisons never look them up
+    if (a.volume != b.volume)
+        return paths->get(a.volume) < paths->get(b.volume);
+    if (a.path != b.path)
+        return paths->get(a.path) < paths->get(b.path);
+    if (a.name != b.name)
+        return paths->get(a.name) < paths->get(b.name);
+    return false;
+}
+
+//the order of file_order, for matches read back from runs
+static bool fileOrder(const file_info &a, const file_info &b)
+{
+    if (a.volume != b.volume)
+        return a.volume < b.volume;
+    if (a.path != b.path)
+        return a.path < b.path;
+    return a.name < b.name;
+}
+
+static bool writeString(FILE *run, const std::string &s)
+{
+    uint32_t length = s.size();
+    return fwrite(&length, sizeof(length), 1, run) == 1 &&
+        (length == 0 || fwrite(s.data(), length, 1, run) == 1);
+}
+
+static bool readString(FILE *run, std::string &s)
+{
+    uint32_t length;
+    if (fread(&length, sizeof(length), 1, run) != 1)
+        return false;
+    s.resize(length);
+    return length == 0 || fread(&s[0], length, 1, run) == 1;
+}
+
+/*
+ * The files, already in file_order: file system offset and inode, then
+ * volume, path and name as length-prefixed strings, so the run does not
+ * depend on the pool.
+ */
+static bool writeFile(FILE *run, TSK_OFF_T fsOffset, TSK_INUM_T addr,
+        const std::string &volume, const std::string &path,
+        const std::string &name)
+{
+    int64_t offset = fsOffset;
+    uint64_t inum = addr;
+    return fwrite(&offset, sizeof(offset), 1, run) == 1 &&
+        fwrite(&inum, sizeof(inum), 1, run) == 1 &&
+        writeString(run, volume) && writeString(run, path) &&
+        writeString(run, name);
+}
+
+bool writeFileRun(FILE *run, const std::vector<file_ref> &files,
+        PathPool *paths)
+{
+    for (size_t f = 0; f < files.size(); f++)
+        if (!writeFile(run, files[f].fsOffset, files[f].inum,
+                    paths->get(files[f].volume), paths->get(files[f].path),
+                    paths->get(files[f].name)))
+            return false;
+    return fflush(run) == 0;
+}
+
+//one match read back, to be written to a merged run
+bool writeFileInfo(FILE *run, const file_info &file)
+{
+    return writeFile(run, file.fsOffset, file.inum, file.volume, file.path,
+            file.name);
+}
+
+bool readFileInfo(FILE *run, file_info &file)
+{
+    int64_t offset;
+    uint64_t inum;
+    if (fread(&offset, sizeof(offset), 1, run) != 1 ||
+            fread(&inum, sizeof(inum), 1, run) != 1)
+        return false;
+    file.fsOffset = offset;
+    file.inum = inum;
+    return readString(run, file.volume) && readString(run, file.path) &&
+        readString(run, file.name);
+}
+
+//the events in record order, five ints each
+bool writeEventRun(FILE *run, const std::vector<LogEvent*> &events)
+{
+    for (size_t e = 0; e < events.size(); e++)
+    {
+        int32_t record[5] = {events[e]->getEventId(),
+            events[e]->getDateCreated(), events[e]->getDateWritten(),
+            events[e]->getEventCode(), events[e]->startsSegment()};
+        if (fwrite(record, sizeof(record), 1, run) != 1)
+            return false;
+    }
+    return fflush(run) == 0;
+}
+
+bool readEvent(FILE *run, LogEvent &event)
+{
+    int32_t record[5];
+    if (fread(record, sizeof(record), 1, run) != 1)
+        return false;
+    event = LogEvent(record[0], record[1], record[2], record[3]);
+    event.setStartsSegment(record[4] != 0);
+    return true;
+}
+
+//the heap keeps the smallest head in front
+bool
+RunMerge::after(const run_head &a, const run_head &b)
+{
+    return fileOrder(b.file, a.file);
+}
+
+RunMerge::RunMerge(const std::vector<FILE*> &runs) :
+    m_runs(runs)
+{
+    for (size_t r = 0; r < m_runs.size(); r++)
+    {
+        rewind(m_runs[r]);
+        run_head head;
+        head.run = r;
+        if (readFileInfo(m_runs[r], head.file))
+            m_heap.push_back(head);
+    }
+    std::make_heap(m_heap.begin(), m_heap.end(), after);
+}
+
+bool
+RunMerge::next(file_info &file)
+{
+    if (m_heap.empty())
+        return false;
+
+    std::pop_heap(m_heap.begin(), m_heap.end(), after);
+    run_head &head = m_heap.back();
+    file = head.file;
+    if (readFileInfo(m_runs[head.run], head.file))
+        std::push_heap(m_heap.begin(), m_heap.end(), after);
+    else
+        m_heap.pop_back();
+    return true;
+}
+
+FileMerge::FileMerge(AnomalyCollection *collection) :
+    m_paths(collection->getPaths()),
+    m_hasher(collection->getHasher()),
+    m_runs(collection->getRuns()),
+    m_memory(collection->getFiles()),
+    m_next(0)
+{
+    if (!collection->getRuns().empty())
+        std::sort(m_memory.begin(), m_memory.end(), file_order(m_paths));
+}
+
+void
+FileMerge::resolve(const file_ref &ref, file_info &file)
+{
+    file.path = m_paths->get(ref.path);
+    file.name = m_paths->get(ref.name);
+    file.volume = m_paths->get(ref.volume);
+    file.fsOffset = ref.fsOffset;
+    file.inum = ref.inum;
+}
+
+bool
+FileMerge::next(file_info &file)
+{
+    const file_info *head = m_runs.top();
+    bool memory = false;
+    if (m_next < m_memory.size())
+    {
+        resolve(m_memory[m_next], file);
+        memory = (head == NULL || !fileOrder(*head, file));
+    }
+
+    if (memory)
+        m_next++;
+    else if (!m_runs.next(file))
+        return false;
+
+    file.digests = m_hasher ? m_hasher->find(file.fsOffset, file.inum) :
+        NULL;
+    return true;
+}
@@ -0,0 +1,119 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "Anomaly.h"
+
+//a collection only writes a run once it holds this share of the budget
+#define SPILL_RUN_DIVISOR   8
+//and at least this many matches
+#define SPILL_MIN_FILES     4096
+//runs a collection keeps open before merging them into one
+#define SPILL_FAN_IN        64
+
+/*
+ * Bytes of file matches, strings included, and event timelines one
+ * analysis holds in memory, shared by all its threads. Past the limit
+ * the holders write what they have to run files in $TMPDIR (or /tmp),
+ * which are unlinked as soon as they are created. A limit of 0 never
+ * spills.
+ */
+class MemoryBudget
+{
+    private:
+        size_t m_limit;
+        size_t m_used;
+    public:
+        MemoryBudget() : m_limit(0), m_used(0) {}
+        void setLimit(size_t limit) { m_limit = limit; }
+        bool isSet() { return m_limit > 0; }
+        size_t getLimit() { return m_limit; }
+        void charge(size_t bytes) { __sync_fetch_and_add(&m_used, bytes); }
+        void release(size_t bytes) { __sync_fetch_and_sub(&m_used, bytes); }
+        bool exceeded() { return m_limit > 0 && m_used > m_limit; }
+        FILE* createRun();
+};
+
+//orders matches by volume, path and name
+struct file_order
+{
+    PathPool *paths;
+
+    file_order(PathPool *p) : paths(p) {}
+    bool operator()(const file_ref &a, const file_ref &b) const;
+};
+
+bool writeFileRun(FILE *run, const std::vector<file_ref> &files,
+        PathPool *paths);
+bool writeFileInfo(FILE *run, const file_info &file);
+bool readFileInfo(FILE *run, file_info &file);
+bool writeEventRun(FILE *run, const std::vector<LogEvent*> &events);
+bool readEvent(FILE *run, LogEvent &event);
+
+/*
+ * Sorted runs of file matches read back as one sequence in file order,
+ * their heads kept in a heap.
+ */
+class RunMerge
+{
+    private:
+        struct run_head
+        {
+            file_info file;
+            size_t run;
+        };
+
+        std::vector<FILE*> m_runs;
+        std::vector<run_head> m_heap;
+
+        static bool after(const run_head &a, const run_head &b);
+    public:
+        RunMerge(const std::vector<FILE*> &runs);
+        //the next file, without taking it; NULL once all are read
+        const file_info* top()
+            { return m_heap.empty() ? NULL : &m_heap.front().file; }
+        bool next(file_info &file);
+};
+
+/*
+ * Reads a collection's files back: its sorted runs and the matches still
+ * in memory, merged by volume, path and name. Files that never spilled
+ * come in the order they were matched. Paths in memory are only turned
+ * back into strings here. Only one merge of a collection may be open at
+ * a time.
+ */
+class FileMerge
+{
+    private:
+        PathPool *m_paths;
+        FileHasher *m_hasher;
+        RunMerge m_runs;
+        std::vector<file_ref> m_memory;
+        size_t m_next;
+
+        void resolve(const file_ref &ref, file_info &file);
+    public:
+        FileMerge(AnomalyCollection *collection);
+        bool next(file_info &file);
+};
+
+#endif
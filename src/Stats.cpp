@@ -0,0 +1,150 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Stats.h"
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+
+static const char *phaseNames[PHASE_COUNT] = {
+    "other",
+    "image_open",
+    "fs_walk",
+    "log_io",
+    "crc",
+    "decode",
+    "detect",
+    "merge",
+    "file_match",
+    "hash",
+    "output"
+};
+
+bool Stats::s_enabled = false;
+__thread stats_phase_t Stats::s_current = PHASE_OTHER;
+__thread uint64_t Stats::s_wall_mark = 0;
+__thread uint64_t Stats::s_cpu_mark = 0;
+phase_stats Stats::s_phases[PHASE_COUNT];
+uint64_t Stats::s_cache_hits = 0;
+uint64_t Stats::s_cache_misses = 0;
+uint64_t Stats::s_duplicate_logs = 0;
+
+static uint64_t clockNs(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void Stats::enable()
+{
+    s_enabled = true;
+    s_current = PHASE_OTHER;
+    s_wall_mark = clockNs(CLOCK_MONOTONIC);
+    s_cpu_mark = clockNs(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void Stats::charge()
+{
+    uint64_t wall = clockNs(CLOCK_MONOTONIC);
+    uint64_t cpu = clockNs(CLOCK_THREAD_CPUTIME_ID);
+    //a thread's first phase change starts its clocks
+    if (s_wall_mark != 0)
+    {
+        add(s_phases[s_current].wall_ns, wall - s_wall_mark);
+        add(s_phases[s_current].cpu_ns, cpu - s_cpu_mark);
+    }
+    s_wall_mark = wall;
+    s_cpu_mark = cpu;
+}
+
+stats_phase_t Stats::enter(stats_phase_t phase)
+{
+    stats_phase_t previous = s_current;
+    charge();
+    s_current = phase;
+    add(s_phases[phase].entries, 1);
+    return previous;
+}
+
+void Stats::leave(stats_phase_t previous)
+{
+    charge();
+    s_current = previous;
+}
+
+void Stats::writeJson(std::ostream &out)
+{
+    charge();
+
+    phase_stats total = phase_stats();
+    out << "{" << std::endl;
+    out << "  \"phases\": {" << std::endl;
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+        phase_stats &p = s_phases[i];
+        out << "    \"" << phaseNames[i] << "\": {"
+            << "\"wall_ns\": " << p.wall_ns
+            << ", \"cpu_ns\": " << p.cpu_ns
+            << ", \"entries\": " << p.entries
+            << ", \"bytes_read\": " << p.bytes_read
+            << ", \"read_calls\": " << p.read_calls
+            << ", \"records\": " << p.records
+            << ", \"files\": " << p.files
+            << ", \"allocations\": " << p.allocations
+            << "}" << (i + 1 < PHASE_COUNT ? "," : "") << std::endl;
+        total.wall_ns += p.wall_ns;
+        total.cpu_ns += p.cpu_ns;
+        total.bytes_read += p.bytes_read;
+        total.read_calls += p.read_calls;
+        total.records += p.records;
+        total.files += p.files;
+        total.allocations += p.allocations;
+    }
+    out << "  }," << std::endl;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    out << "  \"total\": {"
+        << "\"wall_ns\": " << total.wall_ns
+        << ", \"cpu_ns\": " << total.cpu_ns
+        << ", \"bytes_read\": " << total.bytes_read
+        << ", \"read_calls\": " << total.read_calls
+        << ", \"records\": " << total.records
+        << ", \"files\": " << total.files
+        << ", \"allocations\": " << total.allocations
+        << ", \"peak_rss_kb\": " << usage.ru_maxrss
+        << "}," << std::endl;
+    out << "  \"read_cache\": {"
+        << "\"hits\": " << s_cache_hits
+        << ", \"misses\": " << s_cache_misses
+        << "}," << std::endl;
+    out << "  \"logs\": {"
+        << "\"duplicates\": " << s_duplicate_logs
+        << "}" << std::endl;
+    out << "}" << std::endl;
+}
+
+ssize_t countedFileRead(TSK_FS_FILE *file, TSK_OFF_T offset, char *buf,
+        size_t len, TSK_FS_FILE_READ_FLAG_ENUM flags)
+{
+    ScopedPhase phase(PHASE_LOG_IO);
+    ssize_t read = tsk_fs_file_read(file, offset, buf, len, flags);
+    Stats::addRead(read);
+    return read;
+}
@@ -0,0 +1,119 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <tsk3/libtsk.h>
+#include <stdint.h>
+#include <ostream>
+
+/*
+ * Phases that time and counters are charged to. Phases nest (log I/O
+ * happens inside decoding, which happens inside the FS walk); time is
+ * only ever charged to the innermost active phase of each thread, so the
+ * per-phase numbers add up to the total time spent by all threads.
+ */
+enum stats_phase_t {
+    PHASE_OTHER,
+    PHASE_IMAGE_OPEN,
+    PHASE_FS_WALK,
+    PHASE_LOG_IO,
+    PHASE_CRC,
+    PHASE_DECODE,
+    PHASE_DETECT,
+    PHASE_MERGE,
+    PHASE_FILE_MATCH,
+    PHASE_HASH,
+    PHASE_OUTPUT,
+    PHASE_COUNT
+};
+
+struct phase_stats
+{
+    uint64_t wall_ns;
+    uint64_t cpu_ns;
+    uint64_t entries;
+    uint64_t bytes_read;
+    uint64_t read_calls;
+    uint64_t records;
+    uint64_t files;
+    uint64_t allocations;
+};
+
+class Stats
+{
+    private:
+        static bool s_enabled;
+        static __thread stats_phase_t s_current;
+        static __thread uint64_t s_wall_mark;
+        static __thread uint64_t s_cpu_mark;
+        static phase_stats s_phases[PHASE_COUNT];
+        static uint64_t s_cache_hits;
+        static uint64_t s_cache_misses;
+        static uint64_t s_duplicate_logs;
+        static void charge();
+        static void add(uint64_t &counter, uint64_t count)
+            { __sync_fetch_and_add(&counter, count); }
+    public:
+        static void enable();
+        static bool enabled() { return s_enabled; }
+        static stats_phase_t enter(stats_phase_t phase);
+        static void leave(stats_phase_t previous);
+        static void addRead(ssize_t bytes)
+        {
+            if (!s_enabled) return;
+            add(s_phases[s_current].read_calls, 1);
+            if (bytes > 0) add(s_phases[s_current].bytes_read, bytes);
+        }
+        static void addRecords(uint64_t count)
+            { if (s_enabled) add(s_phases[s_current].records, count); }
+        static void addFile()
+            { if (s_enabled) add(s_phases[s_current].files, 1); }
+        static void addAllocation()
+            { if (s_enabled) add(s_phases[s_current].allocations, 1); }
+        static void addCacheHit()
+            { if (s_enabled) add(s_cache_hits, 1); }
+        static void addCacheMiss()
+            { if (s_enabled) add(s_cache_misses, 1); }
+        static void addDuplicateLog()
+            { if (s_enabled) add(s_duplicate_logs, 1); }
+        static void writeJson(std::ostream &out);
+};
+
+/*
+ * Charges everything that happens during its lifetime to a phase. Costs a
+ * single branch when statistics are disabled.
+ */
+class ScopedPhase
+{
+    private:
+        stats_phase_t m_previous;
+    public:
+        ScopedPhase(stats_phase_t phase) : m_previous(PHASE_COUNT)
+            { if (Stats::enabled()) m_previous = Stats::enter(phase); }
+        ~ScopedPhase()
+            { if (m_previous != PHASE_COUNT) Stats::leave(m_previous); }
+};
+
+/*
+ * tsk_fs_file_read() that is charged to PHASE_LOG_IO.
+ */
+ssize_t countedFileRead(TSK_FS_FILE *file, TSK_OFF_T offset, char *buf,
+        size_t len, TSK_FS_FILE_READ_FLAG_ENUM flags);
+
+#endif
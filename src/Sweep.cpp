@@ -0,0 +1,130 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Sweep.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string>
+
+void
+Sweep::clear()
+{
+    for (size_t t = 0; t < m_logged.size(); t++)
+        releaseLoggedAnomalies(m_logged[t]);
+    m_logged.clear();
+    m_anomalies.clear();
+}
+
+void
+Sweep::setThresholds(const std::vector<jump_thresholds> &thresholds)
+{
+    clear();
+    m_thresholds = thresholds;
+    m_logged.resize(thresholds.size());
+    m_anomalies.resize(thresholds.size(), 0);
+}
+
+/*
+ * Pair up the anomalies of one log under each threshold pair, from the
+ * findings of a SweepDetector run over it.
+ */
+void
+Sweep::addLog(const LogInfo &log, std::vector<log_finding> &found)
+{
+    std::vector<std::vector<Anomaly*> > anomalies(m_thresholds.size());
+    for (size_t i = 0; i < found.size(); i++)
+        anomalies[found[i].value].push_back(new Anomaly(found[i].type,
+                    new LogEvent(&found[i].previous),
+                    new LogEvent(&found[i].event)));
+
+    for (size_t t = 0; t < m_thresholds.size(); t++)
+    {
+        m_anomalies[t] += anomalies[t].size();
+        std::vector<AnomalyPair*> pairs = getPairs(anomalies[t]);
+        releaseAnomalies(anomalies[t], pairs);
+        if (pairs.size() > 0)
+            m_logged[t].push_back(new LoggedAnomalies(new LogInfo(log),
+                        pairs));
+    }
+}
+
+//merge the results of another sweep over the same thresholds
+void
+Sweep::take(Sweep &other)
+{
+    for (size_t t = 0; t < m_thresholds.size(); t++)
+    {
+        m_anomalies[t] += other.m_anomalies[t];
+        m_logged[t].insert(m_logged[t].end(),
+                other.m_logged[t].begin(), other.m_logged[t].end());
+        other.m_logged[t].clear();
+        other.m_anomalies[t] = 0;
+    }
+}
+
+std::vector<sweep_result>
+Sweep::getResults()
+{
+    std::vector<sweep_result> results;
+    for (size_t t = 0; t < m_thresholds.size(); t++)
+    {
+        sweep_result result;
+        result.thresholds = m_thresholds[t];
+        result.anomalies = m_anomalies[t];
+        result.pairs = 0;
+        for (size_t i = 0; i < m_logged[t].size(); i++)
+            result.pairs += m_logged[t][i]->getPairs().size();
+
+        std::vector<AnomalyCollection*> collections =
+            collectAnomalies(m_logged[t]);
+        result.collections = collections.size();
+        releaseCollections(collections);
+        results.push_back(result);
+    }
+    return results;
+}
+
+/*
+ * Read a comma separated list of forward:backward threshold pairs in
+ * seconds. Returns false if any pair is malformed.
+ */
+bool
+parseJumpThresholds(const char *list,
+        std::vector<jump_thresholds> &thresholds)
+{
+    std::vector<jump_thresholds> parsed;
+    const char *item = list;
+    while (true)
+    {
+        char *end;
+        long forward = strtol(item, &end, 10);
+        if (end == item || *end != ':' || forward < 0 || forward > INT_MAX)
+            return false;
+        item = end + 1;
+        long backward = strtol(item, &end, 10);
+        if (end == item || (*end != ',' && *end != '\0') ||
+                backward < 0 || backward > INT_MAX)
+            return false;
+        parsed.push_back(jump_thresholds(forward, backward));
+        if (*end == '\0')
+            break;
+        item = end + 1;
+    }
+
+    thresholds = parsed;
+    return true;
+}
@@ -0,0 +1,62 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <vector>
+#include "Anomaly.h"
+#include "IDetector.h"
+
+//what one threshold pair of a sweep found over all logs
+struct sweep_result
+{
+    jump_thresholds thresholds;
+    size_t anomalies;
+    size_t pairs;
+    size_t collections;
+};
+
+/*
+ * The anomalies a SweepDetector found, kept per threshold pair as if the
+ * analysis had run once with each. Only the pairs are kept, so the
+ * collections each pair of thresholds would give can be counted at the
+ * end without parsing the logs again.
+ */
+class Sweep
+{
+    private:
+        std::vector<jump_thresholds> m_thresholds;
+        std::vector<size_t> m_anomalies;
+        std::vector<std::vector<LoggedAnomalies*> > m_logged;
+
+        void clear();
+    public:
+        ~Sweep() { clear(); }
+        void setThresholds(const std::vector<jump_thresholds> &thresholds);
+        std::vector<jump_thresholds> getThresholds() const
+            { return m_thresholds; }
+        bool empty() { return m_thresholds.empty(); }
+        void addLog(const LogInfo &log, std::vector<log_finding> &found);
+        void take(Sweep &other);
+        std::vector<sweep_result> getResults();
+};
+
+bool parseJumpThresholds(const char *list,
+        std::vector<jump_thresholds> &thresholds);
+
+#endif
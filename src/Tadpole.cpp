@@ -0,0 +1,483 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Tadpole.h"
+#include <algorithm>
+#include <iostream>
+#include <unistd.h>
+#include "Exporter.h"
+#include "FileHasher.h"
+#include "FileProcessor.h"
+#include "FileSummary.h"
+#include "LogProcessor.h"
+#include "PartitionScanner.h"
+#include "Stats.h"
+#include "exceptions/Exception.h"
+
+tadpole_config::tadpole_config() :
+    processFiles(false),
+    summarizeFiles(false),
+    hashes(0),
+    cacheBlockSize(DEFAULT_CACHE_BLOCK_SIZE),
+    cacheBlocks(DEFAULT_CACHE_BLOCKS),
+    prefetch(false),
+    partitions(false),
+    mftScan(false),
+    parallelWalk(false),
+    sniff(false),
+    correlate(false),
+    reorder(false),
+    detectors(0),
+    progressive(false),
+    triage(0),
+    deadline(0),
+    memoryBudget(0),
+    exportDepth(0),
+    since(0),
+    until(0),
+    threads(0)
+{
+}
+
+static bool collectionOrder(AnomalyCollection *c1, AnomalyCollection *c2)
+{
+    return c1->getLogs().size() > c2->getLogs().size();
+}
+
+Analysis::Analysis(const tadpole_config &config) :
+    m_config(config),
+    m_callbacks(NULL),
+    m_logs(new LogProcessor()),
+    m_scanner(NULL),
+    m_partitioned(false),
+    m_type(TSK_IMG_TYPE_DETECT),
+    m_corroborated(NULL),
+    m_hasher(NULL),
+    m_exporter(NULL),
+    m_reported(0)
+{
+    //0 threads is one per CPU
+    if (m_config.threads == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        m_config.threads = cpus > 0 ? cpus : 1;
+    }
+
+    //triage wants an answer, not a running report
+    if (m_config.triage > 0)
+        m_config.progressive = false;
+
+    m_logs->setReadCache(m_config.cacheBlockSize, m_config.cacheBlocks);
+    m_logs->setSniff(m_config.sniff);
+    m_logs->setCorrelate(m_config.correlate);
+    m_logs->setReorder(m_config.reorder);
+    m_logs->setDetectors(m_config.detectors);
+    m_logs->setJumpThresholds(m_config.jumps);
+    m_logs->setSweep(m_config.sweep);
+    m_logs->setProgressive(m_config.progressive);
+    m_logs->setTriage(m_config.triage);
+    m_logs->setTimeWindow(m_config.since, m_config.until);
+    if (m_config.deadline > 0)
+        m_logs->setDeadline(&m_deadline);
+    if (m_config.memoryBudget > 0)
+    {
+        m_budget.setLimit(m_config.memoryBudget);
+        m_logs->setMemoryBudget(&m_budget);
+    }
+    if (!m_config.bodyfile.empty())
+        m_logs->setBodyfile(&m_bodyfile);
+    //summaries list no files to hash
+    if (m_config.hashes && !m_config.summarizeFiles)
+    {
+        m_hasher = new FileHasher(m_config.hashes);
+        if (m_budget.isSet())
+            m_hasher->setBudget(&m_budget);
+    }
+    if (!m_config.exportDir.empty())
+        m_exporter = new FileExporter(m_config.exportDir);
+}
+
+Analysis::~Analysis()
+{
+    releaseCollections(m_collections);
+    releaseLoggedAnomalies(takeLoggedAnomalies());
+    delete m_scanner;
+    delete m_logs;
+    delete m_hasher;
+    delete m_exporter;
+}
+
+void
+Analysis::setImages(int count, const TSK_TCHAR * const *images,
+        TSK_IMG_TYPE_ENUM type)
+{
+    m_images.assign(images, images + count);
+    m_imagePaths.clear();
+    for (int i = 0; i < count; i++)
+        m_imagePaths.push_back(m_images[i].c_str());
+    m_type = type;
+}
+
+bool
+Analysis::fail(const char *fallback)
+{
+    const char *message = tsk_error_get();
+    m_error = message ? message : fallback;
+    tsk_error_reset();
+    return false;
+}
+
+//the budget runs from whichever of scanLogs() and finish() comes first
+void
+Analysis::startDeadline()
+{
+    if (m_config.deadline > 0 && !m_deadline.isSet())
+        m_deadline.start(m_config.deadline);
+}
+
+//opened by whichever of addBuffer(), scanLogs() and finish() comes first
+bool
+Analysis::openBodyfile()
+{
+    if (m_config.bodyfile.empty() || m_bodyfile.isOpen())
+        return true;
+    if (m_bodyfile.open(m_config.bodyfile.c_str()))
+        return true;
+    m_error = "unable to open " + m_config.bodyfile;
+    return false;
+}
+
+void
+Analysis::reportLogs()
+{
+    std::vector<LoggedAnomalies*> logged = m_logs->getLoggedAnomalies();
+    if (m_callbacks)
+        for (size_t i = m_reported; i < logged.size(); i++)
+            m_callbacks->log(logged[i]);
+    m_reported = logged.size();
+}
+
+void
+Analysis::reportProvisional(confidence_t confidence)
+{
+    if (m_callbacks == NULL)
+        return;
+    std::vector<AnomalyCollection*> collections =
+        m_logs->getProvisionalCollections();
+    std::sort(collections.begin(), collections.end(), collectionOrder);
+    m_callbacks->provisional(collections, confidence);
+    releaseCollections(collections);
+}
+
+/*
+ * Look for a volume system once, when partitions were asked for. Returns
+ * true if the partitions are to be scanned separately.
+ */
+bool
+Analysis::findPartitions()
+{
+    if (!m_config.partitions || m_images.empty())
+        return false;
+    if (m_scanner)
+        return m_partitioned;
+
+    m_scanner = new PartitionScanner(m_imagePaths.size(), &m_imagePaths[0],
+            m_type);
+    {
+        ScopedPhase phase(PHASE_IMAGE_OPEN);
+        m_partitioned = m_scanner->findPartitions();
+    }
+    if (!m_partitioned)
+        std::cerr << "No volume system found, scanning image as a whole"
+            << std::endl;
+
+    m_scanner->setPrefetch(m_config.prefetch && m_imagePaths.size() == 1);
+    m_scanner->setMftScan(m_config.mftScan, m_config.threads);
+    m_scanner->setParallelWalk(m_config.parallelWalk);
+    if (m_config.deadline > 0)
+        m_scanner->setDeadline(&m_deadline);
+    return m_partitioned;
+}
+
+/*
+ * Parse a log the caller already holds in memory. The buffer must stay
+ * valid for the duration of the call only.
+ */
+bool
+Analysis::addBuffer(const char *name, const char *data, size_t length,
+        const char *path)
+{
+    if (!openBodyfile())
+        return false;
+    try
+    {
+        if (!m_logs->processBuffer(name, data, length, path))
+        {
+            m_error = std::string("no parser for ") + name;
+            return false;
+        }
+    }
+    catch (Exception &e)
+    {
+        m_error = std::string("unable to parse ") + name;
+        return false;
+    }
+
+    reportLogs();
+    return true;
+}
+
+bool
+Analysis::scanLogs()
+{
+    if (m_images.empty())
+    {
+        m_error = "no image given";
+        return false;
+    }
+
+    startDeadline();
+    if (!openBodyfile())
+        return false;
+    int count = m_imagePaths.size();
+    try
+    {
+        if (findPartitions())
+        {
+            if (m_scanner->processLogs(m_logs))
+                return fail("log scan failed");
+        }
+        else
+        {
+            {
+                ScopedPhase phase(PHASE_IMAGE_OPEN);
+                if (m_logs->openImage(count, &m_imagePaths[0], m_type, 0))
+                    return fail("unable to open image");
+            }
+
+            if (m_config.prefetch && (count != 1 ||
+                        !m_logs->enablePrefetch(m_imagePaths[0])))
+                std::cerr << "Prefetching disabled: not a single raw image"
+                    << std::endl;
+            if (m_logs->findAndProcessLogs())
+                return fail("log scan failed");
+
+            //a progressive scan has only sampled the logs so far, and a
+            //triage or time-budgeted scan only found them
+            if (m_config.progressive)
+            {
+                reportProvisional(CONFIDENCE_SAMPLED);
+                m_logs->refineLogs();
+                reportProvisional(CONFIDENCE_REFINED);
+            }
+            if (m_config.progressive || m_config.triage > 0 ||
+                    m_config.deadline > 0)
+                m_logs->processDeferredLogs();
+        }
+    }
+    catch (Exception &e)
+    {
+        //as addBuffer() does, a log that breaks its parser fails the scan
+        m_error = "unable to parse a log";
+        return false;
+    }
+
+    //collections are built by finish() once every log is in
+    releaseCollections(m_logs->getAnomalyCollections());
+    reportLogs();
+    return true;
+}
+
+/*
+ * Add log results produced elsewhere. They stay owned by the caller and
+ * must outlive the analysis.
+ */
+void
+Analysis::addLoggedAnomalies(const std::vector<LoggedAnomalies*> &logged)
+{
+    m_borrowed.insert(logged.begin(), logged.end());
+    m_logs->addLoggedAnomalies(logged);
+    reportLogs();
+}
+
+/*
+ * Hand the log results this analysis produced over to the caller, who
+ * then frees them with releaseLoggedAnomalies(). They remain part of the
+ * analysis until it is destroyed.
+ */
+std::vector<LoggedAnomalies*>
+Analysis::takeLoggedAnomalies()
+{
+    std::vector<LoggedAnomalies*> logged = m_logs->getLoggedAnomalies();
+    std::vector<LoggedAnomalies*> owned;
+    for (size_t i = 0; i < logged.size(); i++)
+        if (m_borrowed.insert(logged[i]).second)
+            owned.push_back(logged[i]);
+    return owned;
+}
+
+std::vector<LoggedAnomalies*>
+Analysis::getLoggedAnomalies()
+{
+    return m_logs->getLoggedAnomalies();
+}
+
+//what the detectors other than the jump detector found, per log
+std::vector<log_findings>
+Analysis::getFindings()
+{
+    return m_logs->getFindings();
+}
+
+/*
+ * The counts each threshold pair of the sweep gave, in the order they
+ * were configured. Collections are counted before files are matched.
+ */
+std::vector<sweep_result>
+Analysis::getSweep()
+{
+    return m_logs->getSweepResults();
+}
+
+/*
+ * Copy the logs with anomalies, and the matching files queued by the
+ * scan, out of the image. Logs given as buffers have nothing to copy.
+ */
+void
+Analysis::exportObjects()
+{
+    std::vector<LoggedAnomalies*> logged = m_logs->getLoggedAnomalies();
+    for (size_t l = 0; l < logged.size(); l++)
+    {
+        LogInfo *info = logged[l]->getLogInfo();
+        if (info->getFsOffset() >= 0)
+            m_exporter->add(info->getFsOffset(), info->getAddress(),
+                    info->getVolume(), info->getPath(), info->getName());
+    }
+
+    unsigned depth = m_config.exportDepth;
+    m_exporter->run(m_imagePaths.size(), &m_imagePaths[0], m_type,
+            depth > 0 ? depth : m_config.threads,
+            m_config.deadline > 0 ? &m_deadline : NULL);
+}
+
+void
+Analysis::getExportCounts(size_t &exported, size_t &failed)
+{
+    exported = m_exporter ? m_exporter->getExported() : 0;
+    failed = m_exporter ? m_exporter->getFailed() : 0;
+}
+
+/*
+ * Merge the logs' anomalies into collections, match the image's files
+ * against them when asked to, and order them by how many logs agree.
+ * The files are walked for the bodyfile even if none are to be matched.
+ */
+bool
+Analysis::finish()
+{
+    startDeadline();
+    if (!openBodyfile())
+        return false;
+    releaseCollections(m_collections);
+    m_logs->buildCollections();
+    m_collections = m_logs->getAnomalyCollections();
+    //correlated logs only get their anomalies once all are in
+    reportLogs();
+
+    //a triage answer needs no files
+    m_corroborated = NULL;
+    for (size_t i = 0; m_config.triage > 0 && i < m_collections.size(); i++)
+        if (m_collections[i]->getLogCount() >= m_config.triage &&
+                (m_corroborated == NULL || m_collections[i]->getLogCount() >
+                 m_corroborated->getLogCount()))
+            m_corroborated = m_collections[i];
+
+    m_coverage = m_logs->getCoverage();
+    for (size_t i = 0; i < m_collections.size(); i++)
+    {
+        if (m_budget.isSet())
+            m_collections[i]->setBudget(&m_budget);
+        if (m_config.summarizeFiles)
+        {
+            time_t start, end;
+            m_collections[i]->getWindow(start, end);
+            m_collections[i]->setSummary(new FileSummary(start, end));
+        }
+        m_collections[i]->setHasher(m_hasher);
+        if (!m_config.summarizeFiles)
+            m_collections[i]->setExporter(m_exporter);
+    }
+    bool matchFiles = m_config.processFiles && !m_corroborated;
+    std::vector<AnomalyCollection*> none;
+    std::vector<AnomalyCollection*> *matched =
+        matchFiles ? &m_collections : &none;
+    if ((matchFiles || m_bodyfile.isOpen()) && !m_images.empty())
+    {
+        if (findPartitions())
+        {
+            m_scanner->setBodyfile(m_bodyfile.isOpen() ? &m_bodyfile : NULL);
+            bool failed = m_scanner->processFiles(matched);
+            scan_coverage files = m_scanner->getCoverage();
+            m_coverage.filesScanned = files.filesScanned;
+            m_coverage.filesComplete = files.filesComplete;
+            if (failed)
+                return fail("file scan failed");
+        }
+        else
+        {
+            int count = m_imagePaths.size();
+            FileProcessor fp(matched);
+            fp.setBodyfile(m_bodyfile.isOpen() ? &m_bodyfile : NULL);
+            fp.setMftScan(m_config.mftScan, m_config.threads);
+            if (m_config.parallelWalk)
+                fp.setParallelWalk(count, &m_imagePaths[0], m_type);
+            fp.setDeadline(m_config.deadline > 0 ? &m_deadline : NULL);
+            {
+                ScopedPhase phase(PHASE_IMAGE_OPEN);
+                if (fp.openImage(count, &m_imagePaths[0], m_type, 0))
+                    return fail("unable to open image");
+            }
+            bool failed = fp.findAndProcessFiles();
+            m_coverage.filesScanned = fp.getFilesScanned();
+            m_coverage.filesComplete = fp.isComplete();
+            if (failed)
+                return fail("file scan failed");
+        }
+
+        if (m_hasher && matchFiles)
+            m_hasher->run(m_imagePaths.size(), &m_imagePaths[0], m_type,
+                    m_config.threads,
+                    m_config.deadline > 0 ? &m_deadline : NULL);
+    }
+
+    if (m_exporter && !m_images.empty())
+        exportObjects();
+
+    if (m_bodyfile.isOpen() && !m_bodyfile.close())
+    {
+        m_error = "unable to write " + m_config.bodyfile;
+        return false;
+    }
+
+    std::sort(m_collections.begin(), m_collections.end(), collectionOrder);
+    if (m_callbacks)
+        for (size_t i = 0; i < m_collections.size(); i++)
+            m_callbacks->collection(m_collections[i]);
+
+    return true;
+}
@@ -0,0 +1,188 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TADPOLE_H
+#define TADPOLE_H
+
+#include <tsk3/libtsk.h>
+#include <time.h>
+#include <set>
+#include <string>
+#include <vector>
+#include "Anomaly.h"
+#include "DetectorSet.h"
+#include "Sweep.h"
+#include "Deadline.h"
+#include "Spill.h"
+#include "Bodyfile.h"
+
+#define TADPOLE_API_VERSION 2
+
+class LogProcessor;
+class PartitionScanner;
+
+//how far a progressive analysis had got when it reported
+enum confidence_t {
+    //from a sample of each log
+    CONFIDENCE_SAMPLED,
+    //with the stretches of logs around each candidate decoded
+    CONFIDENCE_REFINED
+};
+
+/*
+ * Everything that shapes one analysis. The defaults match running the
+ * tadpole program without options.
+ */
+struct tadpole_config
+{
+    bool processFiles;
+    //summarize the matching files of each collection instead of listing
+    bool summarizeFiles;
+    //hash_flag_t bits of the hashes to take of listed matching files
+    unsigned hashes;
+    size_t cacheBlockSize;
+    size_t cacheBlocks;
+    bool prefetch;
+    bool partitions;
+    bool mftScan;
+    bool parallelWalk;
+    bool sniff;
+    bool correlate;
+    bool reorder;
+    //detector_flag_t bits to run besides the jump detector
+    unsigned detectors;
+    jump_thresholds jumps;
+    //further threshold pairs to count anomalies under in the same pass
+    std::vector<jump_thresholds> sweep;
+    //report provisional collections from samples before the full parse;
+    //ignored with partitions
+    bool progressive;
+    //stop once this many logs agree on an anomaly; 0 parses them all, as
+    //partitions always does
+    unsigned triage;
+    //seconds the analysis may take, most valuable work first; 0 is none
+    unsigned deadline;
+    //bytes of file matches and timelines to hold before spilling them
+    //to disk; 0 holds everything in memory
+    size_t memoryBudget;
+    //where to stream a bodyfile timeline of every file and log event
+    //scanned; empty writes none
+    std::string bodyfile;
+    //directory to copy anomalous logs and listed matching files into;
+    //empty copies none
+    std::string exportDir;
+    //objects copied at once; 0 is one per thread
+    unsigned exportDepth;
+    time_t since;
+    time_t until;
+    unsigned threads;
+
+    tadpole_config();
+};
+
+/*
+ * Receives results as an analysis produces them. The objects stay owned
+ * by the Analysis and live until it is destroyed.
+ */
+class AnalysisCallbacks
+{
+    public:
+        virtual ~AnalysisCallbacks() {}
+        //a log with at least one anomaly pair was parsed
+        virtual void log(LoggedAnomalies *logged) {}
+        //a finished collection, with its files if they were scanned
+        virtual void collection(AnomalyCollection *collection) {}
+        //the collections so far of a progressive analysis, freed after
+        //the call; each report replaces the one before it
+        virtual void provisional(
+                const std::vector<AnomalyCollection*> &collections,
+                confidence_t confidence) {}
+};
+
+/*
+ * One analysis of an image, of logs held in memory, or both. Several
+ * may run at once on different threads and their results stay apart,
+ * but the -s counters, the trace collector and tsk_verbose are process
+ * wide, so those report the work of every analysis together.
+ *
+ *   Analysis analysis(config);
+ *   analysis.setImages(1, images, TSK_IMG_TYPE_DETECT);
+ *   if (!analysis.run())
+ *       std::cerr << analysis.getError() << std::endl;
+ *
+ * run() is scanLogs() followed by finish(); callers with log results
+ * from elsewhere may add them in between.
+ */
+class Analysis
+{
+    private:
+        tadpole_config m_config;
+        AnalysisCallbacks *m_callbacks;
+        LogProcessor *m_logs;
+        PartitionScanner *m_scanner;
+        bool m_partitioned;
+        std::vector<std::basic_string<TSK_TCHAR> > m_images;
+        std::vector<const TSK_TCHAR*> m_imagePaths;
+        TSK_IMG_TYPE_ENUM m_type;
+        std::set<LoggedAnomalies*> m_borrowed;
+        std::vector<AnomalyCollection*> m_collections;
+        AnomalyCollection *m_corroborated;
+        Deadline m_deadline;
+        MemoryBudget m_budget;
+        BodyfileWriter m_bodyfile;
+        FileHasher *m_hasher;
+        FileExporter *m_exporter;
+        scan_coverage m_coverage;
+        size_t m_reported;
+        std::string m_error;
+
+        bool findPartitions();
+        bool fail(const char *fallback);
+        void startDeadline();
+        bool openBodyfile();
+        void exportObjects();
+        void reportLogs();
+        void reportProvisional(confidence_t confidence);
+    public:
+        Analysis(const tadpole_config &config = tadpole_config());
+        ~Analysis();
+        void setCallbacks(AnalysisCallbacks *callbacks)
+            { m_callbacks = callbacks; }
+        void setImages(int count, const TSK_TCHAR * const *images,
+                TSK_IMG_TYPE_ENUM type = TSK_IMG_TYPE_DETECT);
+        bool addBuffer(const char *name, const char *data, size_t length,
+                const char *path = "");
+        bool scanLogs();
+        void addLoggedAnomalies(const std::vector<LoggedAnomalies*> &logged);
+        std::vector<LoggedAnomalies*> takeLoggedAnomalies();
+        bool finish();
+        bool run() { return scanLogs() && finish(); }
+        std::vector<LoggedAnomalies*> getLoggedAnomalies();
+        std::vector<AnomalyCollection*> getCollections()
+            { return m_collections; }
+        std::vector<log_findings> getFindings();
+        std::vector<sweep_result> getSweep();
+        //with triage on, the collection enough logs agree on, or NULL
+        AnomalyCollection* getCorroborated() { return m_corroborated; }
+        //what a run under a deadline covered, once finished
+        scan_coverage getCoverage() { return m_coverage; }
+        //how many objects the export copied and how many it could not
+        void getExportCounts(size_t &exported, size_t &failed);
+        std::string getError() { return m_error; }
+};
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TimeWindow.h"
+
+//an event is outside only when both of its times are
+window_side_t
+TimeWindow::side(time_t created, time_t written) const
+{
+    if (m_since != 0 && created < m_since && written < m_since)
+        return WINDOW_BEFORE;
+    if (m_until != 0 && created > m_until && written > m_until)
+        return WINDOW_AFTER;
+    return WINDOW_INSIDE;
+}
+
+/*
+ * Takes ownership of event. Returns the side of the window it fell on.
+ * Only real pairs of consecutive events are kept across an edge; an
+ * event kept after a dropped stretch starts a new segment.
+ */
+window_side_t
+TimeWindow::add(std::vector<LogEvent*> &events, LogEvent *event)
+{
+    window_side_t current = side(event->getDateCreated(),
+            event->getDateWritten());
+
+    if (current == WINDOW_INSIDE ||
+            (m_hasPrevious && m_previousSide != current))
+    {
+        //the pair with the previous event touches the window; m_pending
+        //is that event when it was held back
+        if (m_pending)
+        {
+            m_pending->setStartsSegment(m_pendingDropped);
+            events.push_back(m_pending);
+        }
+        m_pending = NULL;
+        events.push_back(event);
+    }
+    else
+    {
+        //the event before the held one was dropped too
+        m_pendingDropped = (m_pending != NULL);
+        delete m_pending;
+        m_pending = event;
+    }
+
+    m_previousSide = current;
+    m_hasPrevious = true;
+    return current;
+}
@@ -0,0 +1,55 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIME_WINDOW_H
+#define TIME_WINDOW_H
+
+#include <time.h>
+#include <vector>
+#include "ILogParser.h"
+
+enum window_side_t {WINDOW_BEFORE, WINDOW_INSIDE, WINDOW_AFTER};
+
+/*
+ * Streams a log's events, in log order, through the analyst's time
+ * window. Events inside the window are kept, along with both events of
+ * any consecutive pair that enters, leaves or straddles it, so detection
+ * still sees the jumps at its edges. Everything else is dropped as it
+ * arrives, and the next event kept starts a new segment so no pair is
+ * formed across the gap. A bound of 0 leaves that side open.
+ */
+class TimeWindow
+{
+    private:
+        time_t m_since;
+        time_t m_until;
+        //the last event, while it is outside and not yet kept
+        LogEvent *m_pending;
+        bool m_pendingDropped;
+        window_side_t m_previousSide;
+        bool m_hasPrevious;
+    public:
+        TimeWindow(time_t since, time_t until) :
+            m_since(since), m_until(until), m_pending(NULL),
+            m_pendingDropped(false),
+            m_previousSide(WINDOW_INSIDE), m_hasPrevious(false) {};
+        ~TimeWindow() { delete m_pending; }
+        window_side_t side(time_t created, time_t written) const;
+        window_side_t add(std::vector<LogEvent*> &events, LogEvent *event);
+};
+
+#endif
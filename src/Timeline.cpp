@@ -0,0 +1,314 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Timeline.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <queue>
+#include "Stats.h"
+
+struct timeline_cursor
+{
+    int created;
+    size_t source;
+    size_t index;
+};
+
+//priority_queue keeps its largest on top, so the earliest must compare last
+struct cursor_later
+{
+    bool operator()(const timeline_cursor &a, const timeline_cursor &b) const
+    {
+        if (a.created != b.created)
+            return a.created > b.created;
+        return a.source > b.source;
+    }
+};
+
+struct step_candidate
+{
+    size_t source;
+    size_t index;
+    int created;
+    bool confirmed;
+    //the step itself, since its stream will have moved on
+    LogEvent previous;
+    LogEvent next;
+};
+
+typedef std::pair<size_t, Anomaly*> found_anomaly;
+
+static bool foundOrder(const found_anomaly &a, const found_anomaly &b)
+{
+    return a.first < b.first;
+}
+
+static bool backwardJump(LogEvent *previous, LogEvent *next, int delta)
+{
+    return next->getDateCreated() + delta < previous->getDateCreated() ||
+        next->getDateWritten() + delta < previous->getDateWritten();
+}
+
+static bool forwardJump(LogEvent *previous, LogEvent *next, int delta)
+{
+    return next->getDateCreated() - delta > previous->getDateCreated() ||
+        next->getDateWritten() - delta > previous->getDateWritten();
+}
+
+static found_anomaly newAnomaly(anomaly_type_t type, LogEvent *previous,
+        LogEvent *next, size_t index)
+{
+    return found_anomaly(index, new Anomaly(type,
+                new LogEvent(previous), new LogEvent(next)));
+}
+
+//what each event held in memory is charged against the budget
+static size_t eventBytes(size_t count)
+{
+    return count * (sizeof(LogEvent) + sizeof(LogEvent*));
+}
+
+/*
+ * One log's events in record order, from memory or from its run, with
+ * the event before the current one kept for the jump checks.
+ */
+class EventStream
+{
+    private:
+        timeline_source *m_source;
+        size_t m_read;
+        LogEvent m_previous;
+        LogEvent m_current;
+    public:
+        EventStream(timeline_source *source) :
+            m_source(source), m_read(0), m_previous(0, 0, 0),
+            m_current(0, 0, 0)
+            { if (source->run) rewind(source->run); }
+        bool next();
+        size_t index() { return m_read - 1; }
+        LogEvent* previous() { return &m_previous; }
+        LogEvent* current() { return &m_current; }
+};
+
+bool
+EventStream::next()
+{
+    if (m_read >= m_source->count)
+        return false;
+    m_previous = m_current;
+    if (m_source->run == NULL)
+        m_current = *m_source->events[m_read];
+    else if (!readEvent(m_source->run, m_current))
+        return false;
+    m_read++;
+    return true;
+}
+
+//free a source's events, wherever they are held
+static void releaseEvents(timeline_source &source, MemoryBudget *budget)
+{
+    for (size_t e = 0; e < source.events.size(); e++)
+        delete source.events[e];
+    if (budget)
+        budget->release(eventBytes(source.events.size()));
+    source.events.clear();
+    if (source.run)
+        fclose(source.run);
+    source.run = NULL;
+}
+
+Timeline::~Timeline()
+{
+    for (size_t s = 0; s < m_sources.size(); s++)
+    {
+        releaseEvents(m_sources[s], m_budget);
+        delete m_sources[s].info;
+    }
+    for (size_t r = 0; r < m_retired.size(); r++)
+        delete m_retired[r];
+}
+
+void
+Timeline::addSource(LogInfo *info, const std::vector<LogEvent*> &events)
+{
+    timeline_source source;
+    source.info = info;
+    source.events = events;
+    source.run = NULL;
+    source.count = events.size();
+    m_sources.push_back(source);
+
+    if (m_budget)
+    {
+        m_budget->charge(eventBytes(events.size()));
+        if (m_budget->exceeded())
+            spillLargest();
+    }
+}
+
+/*
+ * Write the largest stream still in memory to a run and free its events.
+ * If the run cannot be written the stream stays in memory.
+ */
+void
+Timeline::spillLargest()
+{
+    size_t largest = m_sources.size();
+    for (size_t s = 0; s < m_sources.size(); s++)
+        if (!m_sources[s].events.empty() && (largest == m_sources.size() ||
+                    m_sources[s].events.size() >
+                    m_sources[largest].events.size()))
+            largest = s;
+    if (largest == m_sources.size())
+        return;
+
+    timeline_source &source = m_sources[largest];
+    FILE *run = m_budget->createRun();
+    if (run == NULL)
+        return;
+    if (!writeEventRun(run, source.events))
+    {
+        fclose(run);
+        return;
+    }
+    releaseEvents(source, m_budget);
+    source.run = run;
+}
+
+void
+Timeline::takeSources(Timeline &other)
+{
+    m_sources.insert(m_sources.end(),
+            other.m_sources.begin(), other.m_sources.end());
+    m_retired.insert(m_retired.end(),
+            other.m_retired.begin(), other.m_retired.end());
+    other.m_sources.clear();
+    other.m_retired.clear();
+}
+
+/*
+ * Run detection over the merged timeline and return the anomaly pairs of
+ * every log that has any. The sources are consumed; the LogInfo of a log
+ * without pairs is kept until the timeline is destroyed, since copies of
+ * that log may still be recorded against it.
+ */
+std::vector<LoggedAnomalies*>
+Timeline::detect()
+{
+    ScopedPhase phase(PHASE_DETECT);
+    std::vector<std::vector<found_anomaly> > found(m_sources.size());
+    std::vector<step_candidate> pending;
+
+    std::priority_queue<timeline_cursor, std::vector<timeline_cursor>,
+        cursor_later> heap;
+    std::vector<EventStream> streams;
+    for (size_t s = 0; s < m_sources.size(); s++)
+    {
+        streams.push_back(EventStream(&m_sources[s]));
+        if (!streams[s].next())
+            continue;
+        timeline_cursor cursor = {
+            streams[s].current()->getDateCreated(), s, 0};
+        heap.push(cursor);
+    }
+
+    while (!heap.empty())
+    {
+        timeline_cursor cursor = heap.top();
+        heap.pop();
+        EventStream &stream = streams[cursor.source];
+        LogEvent previous(stream.previous());
+        LogEvent next(stream.current());
+        if (stream.next())
+        {
+            timeline_cursor following = {
+                stream.current()->getDateCreated(),
+                cursor.source, stream.index()};
+            heap.push(following);
+        }
+
+        if (cursor.index == 0 || next.startsSegment())
+            continue;
+
+        std::vector<found_anomaly> &own = found[cursor.source];
+        if (backwardJump(&previous, &next, m_jumps.backward))
+            own.push_back(newAnomaly(BACKWARD_JUMP_ANOMALY,
+                        &previous, &next, cursor.index));
+        else if (forwardJump(&previous, &next, m_jumps.forward))
+            own.push_back(newAnomaly(FORWARD_JUMP_ANOMALY,
+                        &previous, &next, cursor.index));
+        else if (backwardJump(&previous, &next, CORRELATED_BACKWARD_DELTA))
+        {
+            step_candidate step = {cursor.source, cursor.index,
+                previous.getDateCreated(), false, previous, next};
+
+            //steps the merged timeline has moved past can no longer match;
+            //the position is the event just popped, not the latest time
+            //seen, since one log's far-future stamp would pass them all
+            size_t kept = 0;
+            for (size_t p = 0; p < pending.size(); p++)
+                if (pending[p].created + CORRELATION_WINDOW >=
+                        cursor.created)
+                    pending[kept++] = pending[p];
+            pending.erase(pending.begin() + kept, pending.end());
+
+            for (size_t p = 0; p < pending.size(); p++)
+            {
+                step_candidate &other = pending[p];
+                if (other.source == step.source ||
+                        abs(other.created - step.created) >
+                        CORRELATION_WINDOW)
+                    continue;
+                if (!other.confirmed)
+                {
+                    found[other.source].push_back(
+                            newAnomaly(BACKWARD_JUMP_ANOMALY,
+                                &other.previous, &other.next,
+                                other.index));
+                    other.confirmed = true;
+                }
+                step.confirmed = true;
+            }
+            if (step.confirmed)
+                own.push_back(newAnomaly(BACKWARD_JUMP_ANOMALY,
+                            &previous, &next, cursor.index));
+            pending.push_back(step);
+        }
+    }
+
+    std::vector<LoggedAnomalies*> logged;
+    for (size_t s = 0; s < m_sources.size(); s++)
+    {
+        //confirmed steps may come in after later anomalies of their log
+        std::stable_sort(found[s].begin(), found[s].end(), foundOrder);
+        std::vector<Anomaly*> anomalies;
+        for (size_t a = 0; a < found[s].size(); a++)
+            anomalies.push_back(found[s][a].second);
+
+        std::vector<AnomalyPair*> pairs = getPairs(anomalies);
+        releaseAnomalies(anomalies, pairs);
+        if (pairs.size() > 0)
+            logged.push_back(new LoggedAnomalies(m_sources[s].info, pairs));
+        else
+            m_retired.push_back(m_sources[s].info);
+
+        releaseEvents(m_sources[s], m_budget);
+    }
+    m_sources.clear();
+
+    return logged;
+}
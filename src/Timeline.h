@@ -0,0 +1,71 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <vector>
+#include "ILogParser.h"
+#include "Anomaly.h"
+#include "Spill.h"
+
+//smaller backward steps are only anomalies when another log agrees
+#define CORRELATED_BACKWARD_DELTA   60
+#define CORRELATION_WINDOW          300
+
+struct timeline_source
+{
+    LogInfo *info;
+    std::vector<LogEvent*> events;
+    //the events once spilled to a run file, or NULL
+    FILE *run;
+    size_t count;
+};
+
+/*
+ * The event streams of several logs, kept apart until every log is in and
+ * then walked as one timeline. A heap k-way merges the streams by time,
+ * each stream advancing in its own record order, so detection sees all
+ * logs interleaved in a single pass without concatenating them. Each log
+ * keeps its own previous event for the usual jump checks. A backward step
+ * too small to count on its own becomes an anomaly when a step in another
+ * log lands within CORRELATION_WINDOW of it on the merged timeline.
+ * Under a memory budget the largest streams are written out to run
+ * files as logs come in and read back in order by detect().
+ */
+class Timeline
+{
+    private:
+        std::vector<timeline_source> m_sources;
+        std::vector<LogInfo*> m_retired;
+        jump_thresholds m_jumps;
+        MemoryBudget *m_budget;
+
+        void spillLargest();
+    public:
+        Timeline() : m_budget(NULL) {}
+        ~Timeline();
+        void setJumpThresholds(const jump_thresholds &jumps)
+            { m_jumps = jumps; }
+        void setBudget(MemoryBudget *budget) { m_budget = budget; }
+        void addSource(LogInfo *info, const std::vector<LogEvent*> &events);
+        void takeSources(Timeline &other);
+        bool empty() { return m_sources.empty(); }
+        std::vector<LoggedAnomalies*> detect();
+};
+
+#endif
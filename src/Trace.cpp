@@ -0,0 +1,122 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Trace.h"
+
+#ifdef TADPOLE_TRACING
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+struct trace_event
+{
+    const char *name;
+    long tid;
+    uint64_t ts;
+    uint64_t dur;
+    std::string args;
+};
+
+static std::vector<trace_event> events;
+static pthread_mutex_t eventsLock = PTHREAD_MUTEX_INITIALIZER;
+
+bool Trace::s_enabled = false;
+
+uint64_t Trace::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+void Trace::complete(const char *name, uint64_t start,
+        const std::string &args)
+{
+    trace_event event;
+    event.name = name;
+    event.tid = syscall(SYS_gettid);
+    event.ts = start;
+    event.dur = now() - start;
+    event.args = args;
+
+    pthread_mutex_lock(&eventsLock);
+    events.push_back(event);
+    pthread_mutex_unlock(&eventsLock);
+}
+
+static void escape(std::ostream &out, const char *s)
+{
+    for (; *s; s++)
+    {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (c < 0x20)
+            out << ' ';
+        else
+            out << c;
+    }
+}
+
+TraceScope::~TraceScope()
+{
+    if (!Trace::enabled())
+        return;
+
+    std::ostringstream args;
+    if (m_file)
+    {
+        args << "\"file\": \"";
+        escape(args, m_path);
+        escape(args, m_file);
+        args << "\"";
+    }
+    else if (m_index >= 0)
+        args << "\"index\": " << m_index;
+
+    Trace::complete(m_name, m_start, args.str());
+}
+
+bool Trace::write(const char *file)
+{
+    std::ofstream out(file);
+    if (!out)
+        return false;
+
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        out << "{\"name\": \"" << events[i].name << "\""
+            << ", \"ph\": \"X\""
+            << ", \"pid\": " << getpid()
+            << ", \"tid\": " << events[i].tid
+            << ", \"ts\": " << events[i].ts
+            << ", \"dur\": " << events[i].dur
+            << ", \"args\": {" << events[i].args << "}}"
+            << (i + 1 < events.size() ? "," : "") << std::endl;
+    }
+    out << "]}" << std::endl;
+
+    return true;
+}
+
+#endif
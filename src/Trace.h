@@ -0,0 +1,85 @@
+/*
+ *   This file is part of TADpole.
+ *
+ *   TADpole is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TADpole is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TADpole.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <config.h>
+
+/*
+ * Scoped timeline tracing in the Chrome trace-event format (load the
+ * output in chrome://tracing or ui.perfetto.dev). The hooks only exist
+ * when configured with --enable-tracing; otherwise every TRACE_* macro
+ * expands to nothing.
+ */
+#ifdef TADPOLE_TRACING
+
+#include <stdint.h>
+#include <string>
+
+class Trace
+{
+    private:
+        static bool s_enabled;
+    public:
+        static void enable() { s_enabled = true; }
+        static bool enabled() { return s_enabled; }
+        static uint64_t now();
+        static void complete(const char *name, uint64_t start,
+                const std::string &args);
+        static bool write(const char *file);
+};
+
+class TraceScope
+{
+    private:
+        const char *m_name;
+        const char *m_path;
+        const char *m_file;
+        int64_t m_index;
+        uint64_t m_start;
+    public:
+        TraceScope(const char *name) :
+            m_name(name), m_path(NULL), m_file(NULL), m_index(-1),
+            m_start(Trace::enabled() ? Trace::now() : 0) {}
+        TraceScope(const char *name, const char *path, const char *file) :
+            m_name(name), m_path(path), m_file(file), m_index(-1),
+            m_start(Trace::enabled() ? Trace::now() : 0) {}
+        TraceScope(const char *name, int64_t index) :
+            m_name(name), m_path(NULL), m_file(NULL), m_index(index),
+            m_start(Trace::enabled() ? Trace::now() : 0) {}
+        ~TraceScope();
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_VAR TRACE_CONCAT(traceScope, __LINE__)
+
+#define TRACE_SCOPE(name) TraceScope TRACE_VAR(name)
+#define TRACE_SCOPE_FILE(name, path, file) \
+    TraceScope TRACE_VAR(name, path, file)
+#define TRACE_SCOPE_INDEX(name, index) TraceScope TRACE_VAR(name, index)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_SCOPE_FILE(name, path, file)
+#define TRACE_SCOPE_INDEX(name, index)
+
+#endif
+
+#endif
@@ -17,26 +17,31 @@
 
 #include <algorithm>
 #include <config.h>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <locale.h>
+#include <set>
 #include <time.h>
+#include <unistd.h>
 #include <tsk3/libtsk.h>
-#include "LogProcessor.h"
-#include "FileProcessor.h"
+#include "Tadpole.h"
+#include "Daemon.h"
+#include "Digest.h"
+#include "FileSummary.h"
 #include "Options.h"
+#include "Stats.h"
+#include "Trace.h"
 
 #define SPACER "  "
+//exit status of a triage run that found tampering
+#define TRIAGE_FOUND 2
 
 static TSK_TCHAR *progname;
 
-bool collectionSortFunction (AnomalyCollection* c1, AnomalyCollection* c2)
-{
-    return (c1->getLogs().size() > c2->getLogs().size());
-}
-
 void spacer(int count)
 {
     for (int i = 0; i < count; i++)
@@ -64,16 +69,363 @@ void writeTime(time_t* t)
     std::cout << timeinfo->tm_sec;
 }
 
+void writeFinding(log_finding &finding)
+{
+    time_t before = finding.previous.getDateCreated();
+    time_t after = finding.event.getDateCreated();
+    spacer(4);
+    switch (finding.type)
+    {
+        case RECORD_GAP_ANOMALY:
+            std::cout << "records " << finding.event.getEventId() -
+                finding.value << "-" << finding.event.getEventId() - 1
+                << " missing: ";
+            writeTime(&before);
+            std::cout << " - ";
+            writeTime(&after);
+            break;
+        case TIME_DIVERGENCE_ANOMALY:
+            std::cout << "record " << finding.event.getEventId()
+                << " written " << finding.value
+                << "s from its creation at ";
+            writeTime(&after);
+            break;
+        case RATE_CHANGE_ANOMALY:
+            std::cout << finding.value << " events in the hour ";
+            writeTime(&before);
+            std::cout << " - ";
+            writeTime(&after);
+            break;
+        case CLOCK_EVENT_ANOMALY:
+            std::cout << "clock change event " << finding.value
+                << " (record " << finding.event.getEventId() << ") at ";
+            writeTime(&after);
+            break;
+        default:
+            std::cout << anomalyTypeName(finding.type) << ": ";
+            writeTime(&before);
+            std::cout << " - ";
+            writeTime(&after);
+    }
+    std::cout << std::endl;
+}
+
+/*
+ * The short report of a triage run. Returns the exit status, TRIAGE_FOUND
+ * when enough logs agree on an anomaly and 0 otherwise.
+ */
+int writeTriage(AnomalyCollection *collection, unsigned logs)
+{
+    if (collection == NULL)
+    {
+        std::cout << "No anomaly found by " << logs << " or more logs"
+            << std::endl;
+        return 0;
+    }
+
+    time_t start = collection->getPair()->getPreviousAnomaly()
+        ->getPreviousEvent()->getDateCreated();
+    time_t end = collection->getPair()->getNextAnomaly()->getNextEvent()
+        ->getDateCreated();
+    std::cout << "Clock tampering indicated: " << collection->getLogCount()
+        << " logs agree" << std::endl;
+    spacer(2);
+    std::cout << "real    (created): ";
+    writeTime(&start);
+    std::cout << " - ";
+    writeTime(&end);
+    std::cout << std::endl;
+
+    spacer(2);
+    std::cout << "logs:" << std::endl;
+    std::set<LogInfo*> seen;
+    std::vector<LoggedAnomaly*> logged = collection->getLogs();
+    for (size_t l = 0; l < logged.size(); l++)
+    {
+        LogInfo *info = logged[l]->getLogInfo();
+        if (!seen.insert(info).second)
+            continue;
+        spacer(4);
+        if (!info->getVolume().empty())
+            std::cout << "[" << info->getVolume() << "] ";
+        std::cout << info->getPath() << info->getName() << std::endl;
+    }
+    return TRIAGE_FOUND;
+}
+
+/*
+ * The matching files of a collection as counts: the busiest directories
+ * and top-level directories, estimated distinct directories and names,
+ * and the matching MAC times per bucket of the window.
+ */
+void writeSummary(FileSummary *summary)
+{
+    //writeTime() leaves the fill at '0'
+    std::cout << std::setfill(' ');
+    spacer(2);
+    std::cout << "files: " << summary->getFileCount() << " matched, ~"
+        << summary->getDistinctDirectories() << " directories, ~"
+        << summary->getDistinctNames() << " names" << std::endl;
+
+    std::vector<key_count> top = summary->getTopDirectories();
+    if (top.size() > 0)
+    {
+        spacer(3);
+        std::cout << "top directories:" << std::endl;
+    }
+    for (size_t d = 0; d < top.size(); d++)
+    {
+        spacer(4);
+        std::cout << std::setw(10) << top[d].count << "  " << top[d].key
+            << std::endl;
+    }
+
+    std::vector<key_count> prefixes = summary->getPrefixes();
+    if (prefixes.size() > 0)
+    {
+        spacer(3);
+        std::cout << "by top-level directory:" << std::endl;
+    }
+    for (size_t p = 0; p < prefixes.size(); p++)
+    {
+        spacer(4);
+        std::cout << std::setw(10) << prefixes[p].count << "  "
+            << prefixes[p].key << std::endl;
+    }
+
+    std::vector<uint64_t> buckets = summary->getBuckets();
+    spacer(3);
+    std::cout << "MAC times per " << summary->getBucketSeconds() / 3600
+        << "h:" << std::endl;
+    for (size_t b = 0; b < buckets.size(); b++)
+    {
+        if (buckets[b] == 0)
+            continue;
+        time_t start = summary->getStart() +
+            (time_t)b * summary->getBucketSeconds();
+        spacer(4);
+        writeTime(&start);
+        std::cout << "  " << buckets[b] << std::endl;
+    }
+}
+
+void writeSummaryXml(FileSummary *summary)
+{
+    spacer(2);
+    std::cout << "<summary files=\"" << summary->getFileCount()
+        << "\" directories=\"" << summary->getDistinctDirectories()
+        << "\" names=\"" << summary->getDistinctNames() << "\">"
+        << std::endl;
+
+    std::vector<key_count> top = summary->getTopDirectories();
+    for (size_t d = 0; d < top.size(); d++)
+    {
+        spacer(3);
+        std::cout << "<directory count=\"" << top[d].count << "\" error=\""
+            << top[d].error << "\">" << top[d].key << "</directory>"
+            << std::endl;
+    }
+    std::vector<key_count> prefixes = summary->getPrefixes();
+    for (size_t p = 0; p < prefixes.size(); p++)
+    {
+        spacer(3);
+        std::cout << "<prefix count=\"" << prefixes[p].count << "\" error=\""
+            << prefixes[p].error << "\">" << prefixes[p].key << "</prefix>"
+            << std::endl;
+    }
+
+    std::vector<uint64_t> buckets = summary->getBuckets();
+    for (size_t b = 0; b < buckets.size(); b++)
+    {
+        if (buckets[b] == 0)
+            continue;
+        time_t start = summary->getStart() +
+            (time_t)b * summary->getBucketSeconds();
+        spacer(3);
+        std::cout << "<bucket seconds=\"" << summary->getBucketSeconds()
+            << "\" count=\"" << buckets[b] << "\">";
+        writeTime(&start);
+        std::cout << "</bucket>" << std::endl;
+    }
+    spacer(2);
+    std::cout << "</summary>" << std::endl;
+}
+
+/*
+ * What a run under a deadline got to, so its results can be weighed.
+ * Files are only mentioned when they were asked for.
+ */
+void writeCoverage(const scan_coverage &coverage, bool files)
+{
+    std::cout << "Coverage" << std::endl;
+    spacer(2);
+    std::cout << "logs:  " << coverage.logsParsed << " of "
+        << coverage.logsFound << " parsed (" << coverage.bytesParsed
+        << " bytes), " << coverage.logsSkipped << " skipped ("
+        << coverage.bytesSkipped << " bytes)" << std::endl;
+    spacer(2);
+    std::cout << "walk:  " << (coverage.walkComplete ? "complete" :
+            "stopped at the deadline") << std::endl;
+    if (!files)
+        return;
+    spacer(2);
+    std::cout << "files: " << coverage.filesScanned << " scanned, "
+        << (coverage.filesComplete ? "complete" : "stopped at the deadline")
+        << std::endl;
+}
+
+/*
+ * Prints the provisional reports of a progressive analysis. On a terminal
+ * each report is drawn over the one before it, and the final report over
+ * the last; otherwise they follow one another.
+ */
+class ProgressReport : public AnalysisCallbacks
+{
+    private:
+        bool m_inPlace;
+        int m_lines;
+    public:
+        ProgressReport() : m_inPlace(isatty(STDOUT_FILENO)), m_lines(0) {}
+        virtual void provisional(
+                const std::vector<AnomalyCollection*> &collections,
+                confidence_t confidence);
+        void clear();
+};
+
+void ProgressReport::clear()
+{
+    //move to the start of the report and erase to the end of the screen
+    if (m_inPlace && m_lines > 0)
+        std::cout << "\033[" << m_lines << "F\033[J";
+    m_lines = 0;
+}
+
+void ProgressReport::provisional(
+        const std::vector<AnomalyCollection*> &collections,
+        confidence_t confidence)
+{
+    clear();
+    std::cout << "Provisional anomalies (confidence: "
+        << (confidence == CONFIDENCE_SAMPLED ? "sampled" : "refined")
+        << ")" << std::endl;
+    for (size_t i = 0; i < collections.size(); i++)
+    {
+        AnomalyPair *pair = collections[i]->getPair();
+        time_t start = pair->getPreviousAnomaly()->getPreviousEvent()
+            ->getDateCreated();
+        time_t end = pair->getNextAnomaly()->getNextEvent()->getDateCreated();
+        spacer(2);
+        writeTime(&start);
+        std::cout << " - ";
+        writeTime(&end);
+        std::cout << " (" << collections[i]->getLogs().size() << " logs)"
+            << std::endl;
+    }
+    m_lines = collections.size() + 1;
+}
+
+/*
+ * Parse a window bound given as UNIX seconds or as local time in the
+ * report's YYYY-MM-DDTHH:MM:SS form. Returns -1 when neither matches.
+ */
+static time_t parseTime(const TSK_TCHAR *arg)
+{
+    TSK_TCHAR *end;
+    unsigned long seconds = TSTRTOUL(arg, &end, 10);
+    if (end != arg && *end == 0)
+        return (time_t)seconds;
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+#ifdef TSK_WIN32
+    if (swscanf(arg, L"%d-%d-%dT%d:%d:%d",
+#else
+    if (sscanf(arg, "%d-%d-%dT%d:%d:%d",
+#endif
+                &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+        return (time_t)-1;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
 static void usage ()
 {
     std::cerr << "usage: " << progname << " [options] image [image]"
         << std::endl;
+    std::cerr << "       " << progname << " [options] -D socket" << std::endl;
     std::cerr << "\tOPTIONS:" << std::endl;
     std::cerr << "\t-i imgtype: The format of the image file\n"
         << "\t\t(use '-i list' for supported types)" << std::endl;
     std::cerr << "\t-f: Scan files in image for anomalies in MAC time" << std::endl;
+    std::cerr << "\t-F: Summarize the matching files of each anomaly"
+        << " instead of\n\t\tlisting them (implies -f)" << std::endl;
+    std::cerr << "\t-H hashes: Hash the content of the matching files,"
+        << " comma separated\n\t\t(md5, sha1, sha256; implies -f)"
+        << std::endl;
+    std::cerr << "\t-o bodyfile: Also write the MAC times of every file and"
+        << " the times of\n\t\tevery log event scanned to bodyfile,"
+        << " for mactime" << std::endl;
+    std::cerr << "\t-X directory: Copy the logs with anomalies, and with -f"
+        << " the matching\n\t\tfiles, out of the image into directory"
+        << std::endl;
+    std::cerr << "\t-k depth: Objects -X copies at once"
+        << " (default: -t threads)" << std::endl;
     std::cerr << "\t-x: Output in XML format" << std::endl;
     std::cerr << "\t-v: verbose output to stderr" << std::endl;
+    std::cerr << "\t-s statsfile: Write per-phase performance statistics\n"
+        << "\t\tas JSON to statsfile (use '-' for stderr)" << std::endl;
+    std::cerr << "\t-B blocksize: Read cache block size in bytes"
+        << " (default " << DEFAULT_CACHE_BLOCK_SIZE << ")" << std::endl;
+    std::cerr << "\t-C blocks: Read cache capacity in blocks per log,"
+        << " 0 disables\n\t\tthe cache (default " << DEFAULT_CACHE_BLOCKS
+        << ")" << std::endl;
+    std::cerr << "\t-a since: Only keep log events from since onward\n"
+        << "\t\t(UNIX seconds or YYYY-MM-DDTHH:MM:SS local time)"
+        << std::endl;
+    std::cerr << "\t-b until: Only keep log events up to until"
+        << std::endl;
+    std::cerr << "\t-S: Also identify logs by their file signature"
+        << std::endl;
+    std::cerr << "\t-G: Detect over one timeline merged from all logs"
+        << std::endl;
+    std::cerr << "\t-R: Sort events by record number and report gaps"
+        << std::endl;
+    std::cerr << "\t-d detectors: Also run these detectors, comma separated"
+        << "\n\t\t(gaps, divergence, rate, clock)" << std::endl;
+    std::cerr << "\t-j forward:backward: Seconds a clock jump must exceed"
+        << " (default " << FORWARD_JUMP_DELTA << ":" << BACKWARD_JUMP_DELTA
+        << ")" << std::endl;
+    std::cerr << "\t-J forward:backward,...: Also count anomalies, pairs and"
+        << " collections\n\t\tunder each of these thresholds" << std::endl;
+    std::cerr << "\t-A: Report provisional anomalies from a sample of each"
+        << " log first,\n\t\tthen refine them (not with -p)" << std::endl;
+    std::cerr << "\t-Q logs: Triage: stop as soon as this many logs agree on"
+        << " an anomaly\n\t\tand exit with status " << TRIAGE_FOUND
+        << " (0 if none do)" << std::endl;
+    std::cerr << "\t-E seconds: Stop by this deadline, most valuable logs"
+        << " first,\n\t\tand report what was covered" << std::endl;
+    std::cerr << "\t-m megabytes: Spill file matches and merged timelines"
+        << " past this\n\t\tmuch memory to sorted runs in $TMPDIR"
+        << std::endl;
+    std::cerr << "\t-p: Scan each partition of a volume system in parallel"
+        << std::endl;
+    std::cerr << "\t-M: Collect NTFS MAC times with a sequential $MFT scan"
+        << std::endl;
+    std::cerr << "\t-W: Walk directories of other file systems in parallel"
+        << std::endl;
+    std::cerr << "\t-t threads: Worker threads for parallel scans"
+        << " (default: one per CPU)" << std::endl;
+    std::cerr << "\t-P: Prefetch log data ahead of the parser"
+        << " (single raw images only)" << std::endl;
+    std::cerr << "\t-D socket: Serve NDJSON analysis requests on a Unix"
+        << " socket" << std::endl;
+#ifdef TADPOLE_TRACING
+    std::cerr << "\t-T tracefile: Write a Chrome trace-event timeline"
+        << " to tracefile" << std::endl;
+#endif
     std::cerr << std::endl;
 
     exit(1);
@@ -84,8 +436,10 @@ int main (int argc, char* argv1[])
     TSK_IMG_TYPE_ENUM imgtype = TSK_IMG_TYPE_DETECT;
     int ch;
     TSK_TCHAR **argv;
-    LogProcessor lp;
+    struct options opt;
     time_t temptime;
+    unsigned detectors;
+    std::vector<jump_thresholds> thresholds;
 
 #ifdef TSK_WIN32
     argv = CommandLineToArgvW(GetCommandLineW(), &argc);
@@ -101,7 +455,7 @@ int main (int argc, char* argv1[])
     progname = argv[0];
     setlocale(LC_ALL, "");
 
-    while ((ch = GETOPT(argc, argv, _TSK_T("hlfvi:x"))) > 0 )
+    while ((ch = GETOPT(argc, argv, _TSK_T("hlfvi:xs:T:B:C:PpMWSGRd:j:J:AQ:E:m:FH:o:X:k:t:a:b:D:"))) > 0 )
     {
         switch (ch)
         {
@@ -130,15 +484,219 @@ int main (int argc, char* argv1[])
                 break;
 
             case _TSK_T('f'):
-                opt.processFiles = 1;
+                opt.config.processFiles = true;
+                break;
+
+            case _TSK_T('F'):
+                opt.config.processFiles = true;
+                opt.config.summarizeFiles = true;
+                break;
+
+            case _TSK_T('H'):
+                opt.config.hashes = parseHashNames(OPTARG);
+                if (opt.config.hashes == 0)
+                {
+                    std::cerr << "Unknown hash in: " << OPTARG
+                        << std::endl;
+                    usage();
+                }
+                opt.config.processFiles = true;
+                break;
+
+            case _TSK_T('o'):
+                opt.config.bodyfile = OPTARG;
+                break;
+
+            case _TSK_T('X'):
+                opt.config.exportDir = OPTARG;
+                break;
+
+            case _TSK_T('k'):
+                opt.config.exportDepth = TSTRTOUL(OPTARG, NULL, 0);
+                if (opt.config.exportDepth == 0)
+                {
+                    std::cerr << "Invalid export depth: " << OPTARG
+                        << std::endl;
+                    usage();
+                }
                 break;
 
             case _TSK_T('x'):
                 opt.xml = 1;
                 break;
+
+            case _TSK_T('s'):
+                opt.statsFile = OPTARG;
+                Stats::enable();
+                break;
+
+            case _TSK_T('B'):
+                opt.config.cacheBlockSize = TSTRTOUL(OPTARG, NULL, 0);
+                if (opt.config.cacheBlockSize == 0)
+                {
+                    std::cerr << "Invalid cache block size: " << OPTARG
+                        << std::endl;
+                    usage();
+                }
+                break;
+
+            case _TSK_T('C'):
+                opt.config.cacheBlocks = TSTRTOUL(OPTARG, NULL, 0);
+                break;
+
+            case _TSK_T('a'):
+                opt.config.since = parseTime(OPTARG);
+                if (opt.config.since == (time_t)-1)
+                {
+                    std::cerr << "Invalid time: " << OPTARG << std::endl;
+                    usage();
+                }
+                break;
+
+            case _TSK_T('b'):
+                opt.config.until = parseTime(OPTARG);
+                if (opt.config.until == (time_t)-1)
+                {
+                    std::cerr << "Invalid time: " << OPTARG << std::endl;
+                    usage();
+                }
+                break;
+
+            case _TSK_T('S'):
+                opt.config.sniff = true;
+                break;
+
+            case _TSK_T('G'):
+                opt.config.correlate = true;
+                break;
+
+            case _TSK_T('R'):
+                opt.config.reorder = true;
+                break;
+
+            case _TSK_T('d'):
+                detectors = parseDetectorNames(OPTARG);
+                if (detectors == 0)
+                {
+                    std::cerr << "Unknown detector in: " << OPTARG
+                        << std::endl;
+                    usage();
+                }
+                opt.config.detectors |= detectors;
+                break;
+
+            case _TSK_T('j'):
+                if (!parseJumpThresholds(OPTARG, thresholds) ||
+                        thresholds.size() != 1)
+                {
+                    std::cerr << "Invalid thresholds: " << OPTARG
+                        << std::endl;
+                    usage();
+                }
+                opt.config.jumps = thresholds[0];
+                break;
+
+            case _TSK_T('J'):
+                if (!parseJumpThresholds(OPTARG, thresholds))
+                {
+                    std::cerr << "Invalid thresholds: " << OPTARG
+                        << std::endl;
+                    usage();
+                }
+                opt.config.sweep.insert(opt.config.sweep.end(),
+                        thresholds.begin(), thresholds.end());
+                break;
+
+            case _TSK_T('A'):
+                opt.config.progressive = true;
+                break;
+
+            case _TSK_T('Q'):
+                opt.config.triage = TSTRTOUL(OPTARG, NULL, 0);
+                if (opt.config.triage == 0)
+                {
+                    std::cerr << "Invalid log count: " << OPTARG
+                        << std::endl;
+                    usage();
+                }
+                break;
+
+            case _TSK_T('E'):
+                opt.config.deadline = TSTRTOUL(OPTARG, NULL, 0);
+                if (opt.config.deadline == 0)
+                {
+                    std::cerr << "Invalid deadline: " << OPTARG
+                        << std::endl;
+                    usage();
+                }
+                break;
+
+            case _TSK_T('m'):
+                opt.config.memoryBudget = TSTRTOUL(OPTARG, NULL, 0);
+                if (opt.config.memoryBudget == 0)
+                {
+                    std::cerr << "Invalid memory budget: " << OPTARG
+                        << std::endl;
+                    usage();
+                }
+                opt.config.memoryBudget <<= 20;
+                break;
+
+            case _TSK_T('p'):
+                opt.config.partitions = true;
+                break;
+
+            case _TSK_T('M'):
+                opt.config.mftScan = true;
+                break;
+
+            case _TSK_T('W'):
+                opt.config.parallelWalk = true;
+                break;
+
+            case _TSK_T('t'):
+                opt.config.threads = TSTRTOUL(OPTARG, NULL, 0);
+                if (opt.config.threads == 0)
+                {
+                    std::cerr << "Invalid thread count: " << OPTARG
+                        << std::endl;
+                    usage();
+                }
+                break;
+
+            case _TSK_T('P'):
+                opt.config.prefetch = true;
+                break;
+
+            case _TSK_T('D'):
+                opt.daemonSocket = OPTARG;
+                break;
+
+#ifdef TADPOLE_TRACING
+            case _TSK_T('T'):
+                opt.traceFile = OPTARG;
+                Trace::enable();
+                break;
+#endif
         }
     }
 
+    //the deferred passes run per volume, so -p cannot stop or sample early
+    if (opt.config.partitions && opt.config.progressive)
+    {
+        std::cerr << "-A cannot be combined with -p" << std::endl;
+        usage();
+    }
+    if (opt.config.partitions && opt.config.triage > 0 && !opt.daemonSocket)
+        std::cerr << "Triage with -p parses every log before reporting"
+            << std::endl;
+
+    if (opt.daemonSocket)
+    {
+        Daemon server(opt.daemonSocket, opt.config);
+        return server.serve() ? 0 : 1;
+    }
+
     if (OPTIND >= argc)
     {
         //print usage
@@ -147,40 +705,42 @@ int main (int argc, char* argv1[])
         exit(1);
     }
 
-    if (lp.openImage(argc - OPTIND, &argv[OPTIND], imgtype, 0))
+    Analysis analysis(opt.config);
+    analysis.setImages(argc - OPTIND, &argv[OPTIND], imgtype);
+    ProgressReport progress;
+    if (opt.config.progressive && !opt.xml)
+        analysis.setCallbacks(&progress);
+    if (!analysis.run())
     {
-        tsk_error_print(stderr);
+        std::cerr << analysis.getError() << std::endl;
         exit(1);
     }
+    progress.clear();
 
-    if (lp.findAndProcessLogs())
+    if (!opt.config.exportDir.empty())
     {
-        tsk_error_print(stderr);
-        exit(1);
+        size_t exported, failed;
+        analysis.getExportCounts(exported, failed);
+        std::cerr << "Exported " << exported << " of " << exported + failed
+            << " objects to " << opt.config.exportDir << std::endl;
     }
 
-    std::vector<AnomalyCollection*> collections = lp.getAnomalyCollections();
-
-    if (opt.processFiles)
-    {
-        FileProcessor fp(&collections);
-        if (fp.openImage(argc - OPTIND, &argv[OPTIND], imgtype, 0))
-        {
-            tsk_error_print(stderr);
-            exit(1);
-        }
-
-        if (fp.findAndProcessFiles())
-        {
-            tsk_error_print(stderr);
-            exit(1);
-        }
-    }
+    std::vector<AnomalyCollection*> collections = analysis.getCollections();
+    std::vector<log_findings> findings = analysis.getFindings();
+    std::vector<sweep_result> sweep = analysis.getSweep();
+    scan_coverage coverage = analysis.getCoverage();
 
     //report
+    ScopedPhase outputPhase(PHASE_OUTPUT);
     std::vector<AnomalyCollection*>::iterator it;
-    sort(collections.begin(), collections.end(), collectionSortFunction);
-    if (opt.xml)
+    int status = 0;
+    if (opt.config.triage > 0)
+    {
+        status = writeTriage(analysis.getCorroborated(), opt.config.triage);
+        if (opt.config.deadline > 0)
+            writeCoverage(coverage, opt.config.processFiles);
+    }
+    else if (opt.xml)
     {
         std::cout << "<?xml version=\"1.0\"?>" << std::endl;
         std::cout << "<anomalies>" << std::endl;
@@ -236,10 +796,34 @@ int main (int argc, char* argv1[])
             {
                 spacer(3);
                 std::cout << "<log>" << std::endl;
+                if (!(*lit)->getLogInfo()->getVolume().empty())
+                {
+                    spacer(4);
+                    std::cout << "<volume>" << (*lit)->getLogInfo()->getVolume()
+                        << "</volume>" << std::endl;
+                }
                 spacer(4);
                 std::cout << "<path>" << (*lit)->getLogInfo()->getPath() << "</path>" << std::endl;
                 spacer(4);
                 std::cout << "<name>" << (*lit)->getLogInfo()->getName() << "</name>" << std::endl;
+                std::vector<log_location> copies = (*lit)->getLogInfo()->getCopies();
+                for (size_t c = 0; c < copies.size(); c++)
+                {
+                    spacer(4);
+                    std::cout << "<copy>" << std::endl;
+                    if (!copies[c].volume.empty())
+                    {
+                        spacer(5);
+                        std::cout << "<volume>" << copies[c].volume
+                            << "</volume>" << std::endl;
+                    }
+                    spacer(5);
+                    std::cout << "<path>" << copies[c].path << "</path>" << std::endl;
+                    spacer(5);
+                    std::cout << "<name>" << copies[c].name << "</name>" << std::endl;
+                    spacer(4);
+                    std::cout << "</copy>" << std::endl;
+                }
                 spacer(4);
                 std::cout << "<times>" << std::endl;
                 temptime = (*lit)->getPair()->getPreviousAnomaly()->getPreviousEvent()->getDateCreated();
@@ -290,29 +874,144 @@ int main (int argc, char* argv1[])
             spacer(2);
             std::cout << "</logs>" << std::endl;
 
-            if ((*it)->getFiles().size() > 0) {
+            if ((*it)->getFileCount() > 0) {
                 spacer(2);
                 std::cout << "<files>" << std::endl;
-                std::vector<file_info*> files = (*it)->getFiles();
-                std::vector<file_info*>::iterator fit = files.begin();
-                for ( ; fit != files.end(); fit++)
+                FileMerge files(*it);
+                file_info file;
+                while (files.next(file))
                 {
                     spacer(3);
                     std::cout << "<file>" << std::endl;
+                    if (!file.volume.empty())
+                    {
+                        spacer(4);
+                        std::cout << "<volume>" << file.volume
+                            << "</volume>" << std::endl;
+                    }
                     spacer(4);
-                    std::cout << "<path>" << (*fit)->path << "</path>" << std::endl;
+                    std::cout << "<path>" << file.path << "</path>" << std::endl;
                     spacer(4);
-                    std::cout << "<name>" << (*fit)->name << "</name>" << std::endl;
+                    std::cout << "<name>" << file.name << "</name>" << std::endl;
+                    std::vector<std::pair<const char*, std::string> > digests
+                        = listDigests(file.digests);
+                    for (size_t d = 0; d < digests.size(); d++)
+                    {
+                        spacer(4);
+                        std::cout << "<" << digests[d].first << ">"
+                            << digests[d].second << "</" << digests[d].first
+                            << ">" << std::endl;
+                    }
                     spacer(3);
                     std::cout << "</file>" << std::endl;
                 }
                 spacer(2);
                 std::cout << "</files>" << std::endl;
             }
+            if ((*it)->getSummary())
+                writeSummaryXml((*it)->getSummary());
 
             spacer(1);
             std::cout << "</anomaly>" << std::endl;
         }
+        if (findings.size() > 0)
+        {
+            spacer(1);
+            std::cout << "<findings>" << std::endl;
+            for (size_t g = 0; g < findings.size(); g++)
+            {
+                spacer(2);
+                std::cout << "<log>" << std::endl;
+                if (!findings[g].log.volume.empty())
+                {
+                    spacer(3);
+                    std::cout << "<volume>" << findings[g].log.volume
+                        << "</volume>" << std::endl;
+                }
+                spacer(3);
+                std::cout << "<path>" << findings[g].log.path << "</path>" << std::endl;
+                spacer(3);
+                std::cout << "<name>" << findings[g].log.name << "</name>" << std::endl;
+                for (size_t f = 0; f < findings[g].findings.size(); f++)
+                {
+                    log_finding &finding = findings[g].findings[f];
+                    spacer(3);
+                    std::cout << "<finding type=\""
+                        << anomalyTypeName(finding.type) << "\">" << std::endl;
+                    spacer(4);
+                    std::cout << "<record>" << finding.event.getEventId()
+                        << "</record>" << std::endl;
+                    spacer(4);
+                    std::cout << "<value>" << finding.value << "</value>"
+                        << std::endl;
+                    temptime = finding.previous.getDateCreated();
+                    spacer(4);
+                    std::cout << "<before>";
+                    writeTime(&temptime);
+                    std::cout << "</before>" << std::endl;
+                    temptime = finding.event.getDateCreated();
+                    spacer(4);
+                    std::cout << "<after>";
+                    writeTime(&temptime);
+                    std::cout << "</after>" << std::endl;
+                    spacer(3);
+                    std::cout << "</finding>" << std::endl;
+                }
+                spacer(2);
+                std::cout << "</log>" << std::endl;
+            }
+            spacer(1);
+            std::cout << "</findings>" << std::endl;
+        }
+        if (sweep.size() > 0)
+        {
+            spacer(1);
+            std::cout << "<sweep>" << std::endl;
+            for (size_t s = 0; s < sweep.size(); s++)
+            {
+                spacer(2);
+                std::cout << "<thresholds forward=\""
+                    << sweep[s].thresholds.forward << "\" backward=\""
+                    << sweep[s].thresholds.backward << "\">" << std::endl;
+                spacer(3);
+                std::cout << "<anomalies>" << sweep[s].anomalies
+                    << "</anomalies>" << std::endl;
+                spacer(3);
+                std::cout << "<pairs>" << sweep[s].pairs << "</pairs>"
+                    << std::endl;
+                spacer(3);
+                std::cout << "<collections>" << sweep[s].collections
+                    << "</collections>" << std::endl;
+                spacer(2);
+                std::cout << "</thresholds>" << std::endl;
+            }
+            spacer(1);
+            std::cout << "</sweep>" << std::endl;
+        }
+        if (opt.config.deadline > 0)
+        {
+            spacer(1);
+            std::cout << "<coverage deadline=\"" << opt.config.deadline
+                << "\">" << std::endl;
+            spacer(2);
+            std::cout << "<logs found=\"" << coverage.logsFound
+                << "\" parsed=\"" << coverage.logsParsed << "\" skipped=\""
+                << coverage.logsSkipped << "\" bytesParsed=\""
+                << coverage.bytesParsed << "\" bytesSkipped=\""
+                << coverage.bytesSkipped << "\" walkComplete=\""
+                << (coverage.walkComplete ? "true" : "false") << "\"/>"
+                << std::endl;
+            if (opt.config.processFiles)
+            {
+                spacer(2);
+                std::cout << "<files scanned=\"" << coverage.filesScanned
+                    << "\" complete=\""
+                    << (coverage.filesComplete ? "true" : "false")
+                    << "\"/>" << std::endl;
+            }
+            spacer(1);
+            std::cout << "</coverage>" << std::endl;
+        }
         std::cout << "</anomalies>" << std::endl;
     }
     else
@@ -360,23 +1059,108 @@ int main (int argc, char* argv1[])
             for ( ; lit != logs.end(); lit++)
             {
                 spacer(4);
+                if (!(*lit)->getLogInfo()->getVolume().empty())
+                    std::cout << "[" << (*lit)->getLogInfo()->getVolume()
+                        << "] ";
                 std::cout << (*lit)->getLogInfo()->getPath();
                 std::cout << (*lit)->getLogInfo()->getName() << std::endl;
+                std::vector<log_location> copies = (*lit)->getLogInfo()->getCopies();
+                for (size_t c = 0; c < copies.size(); c++)
+                {
+                    spacer(5);
+                    std::cout << "copy: ";
+                    if (!copies[c].volume.empty())
+                        std::cout << "[" << copies[c].volume << "] ";
+                    std::cout << copies[c].path << copies[c].name << std::endl;
+                }
             }
 
-            if ((*it)->getFiles().size() > 0) {
+            if ((*it)->getFileCount() > 0) {
                 spacer(2);
                 std::cout << "files:" << std::endl;
-                std::vector<file_info*> files = (*it)->getFiles();
-                std::vector<file_info*>::iterator fit = files.begin();
-                for ( ; fit != files.end(); fit++)
+                FileMerge files(*it);
+                file_info file;
+                while (files.next(file))
                 {
                     spacer(4);
-                    std::cout << (*fit)->path << (*fit)->name << std::endl;
+                    if (!file.volume.empty())
+                        std::cout << "[" << file.volume << "] ";
+                    std::cout << file.path << file.name << std::endl;
+                    std::vector<std::pair<const char*, std::string> > digests
+                        = listDigests(file.digests);
+                    for (size_t d = 0; d < digests.size(); d++)
+                    {
+                        spacer(6);
+                        std::cout << digests[d].first << ": "
+                            << digests[d].second << std::endl;
+                    }
                 }
             }
+            if ((*it)->getSummary())
+                writeSummary((*it)->getSummary());
+        }
+
+        if (findings.size() > 0)
+            std::cout << "Findings" << std::endl;
+        for (size_t g = 0; g < findings.size(); g++)
+        {
+            spacer(2);
+            if (!findings[g].log.volume.empty())
+                std::cout << "[" << findings[g].log.volume << "] ";
+            std::cout << findings[g].log.path << findings[g].log.name
+                << std::endl;
+            for (size_t f = 0; f < findings[g].findings.size(); f++)
+                writeFinding(findings[g].findings[f]);
+        }
+
+        if (sweep.size() > 0)
+        {
+            std::cout << "Sweep" << std::setfill(' ') << std::endl;
+            spacer(2);
+            std::cout << std::setw(10) << "forward" << std::setw(10)
+                << "backward" << std::setw(12) << "anomalies"
+                << std::setw(8) << "pairs" << std::setw(14)
+                << "collections" << std::endl;
+        }
+        for (size_t s = 0; s < sweep.size(); s++)
+        {
+            spacer(2);
+            std::cout << std::setw(10) << sweep[s].thresholds.forward
+                << std::setw(10) << sweep[s].thresholds.backward
+                << std::setw(12) << sweep[s].anomalies
+                << std::setw(8) << sweep[s].pairs
+                << std::setw(14) << sweep[s].collections << std::endl;
+        }
+
+        if (opt.config.deadline > 0)
+            writeCoverage(coverage, opt.config.processFiles);
+    }
+
+    if (opt.statsFile)
+    {
+        if (TSTRCMP(opt.statsFile, _TSK_T("-")) == 0)
+            Stats::writeJson(std::cerr);
+        else
+        {
+            std::ofstream out(opt.statsFile);
+            if (!out)
+            {
+                std::cerr << "Unable to write stats file: " << opt.statsFile
+                    << std::endl;
+                exit(1);
+            }
+            Stats::writeJson(out);
         }
     }
 
-    return 0;
+#ifdef TADPOLE_TRACING
+    if (opt.traceFile && !Trace::write(opt.traceFile))
+    {
+        std::cerr << "Unable to write trace file: " << opt.traceFile
+            << std::endl;
+        exit(1);
+    }
+#endif
+
+    return status;
 }